@@ -18,23 +18,184 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 #include <obs-module.h>
 #include <plugin-support.h>
+#include <util/threading.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+#include <string.h>
 
 #include "hang-source.h"
+#include "audio-decoder.h"
+
+// Hang broadcasts carry Opus unless the catalog says otherwise, or libmoq cannot read it
+#define DEFAULT_AUDIO_CODEC "opus"
+#define DEFAULT_AUDIO_SAMPLE_RATE 48000
+#define DEFAULT_AUDIO_CHANNELS 2
+
+// Decoded audio waiting for the next video tick; older blocks are dropped beyond this
+#define AUDIO_QUEUE_MAX 64
+
+// WebCodecs codec strings used in catalogs, and the FFmpeg decoders for them. AAC, FLAC and
+// Vorbis are missing because they need the track's description, which the catalog API lacks.
+static const struct {
+	const char *catalog;
+	const char *ffmpeg;
+} catalog_codecs[] = {
+	{"opus", "opus"},
+	{"mp3", "mp3"},
+	{"ulaw", "pcm_mulaw"},
+	{"alaw", "pcm_alaw"},
+	{"pcm-u8", "pcm_u8"},
+	{"pcm-s16", "pcm_s16le"},
+	{"pcm-s24", "pcm_s24le"},
+	{"pcm-s32", "pcm_s32le"},
+	{"pcm-f32", "pcm_f32le"},
+};
 
 struct audio_decoder {
-	// Placeholder for future FFmpeg audio decoder implementation
-	int placeholder;
+	AVCodecContext *codec_ctx;
+	AVPacket *packet;
+	AVFrame *frame;
+
+	// What the decoder was opened for, so an unchanged catalog does not reopen it
+	const char *codec_name;
+	uint32_t sample_rate;
+	uint32_t channels;
+
+	// Packets dropped undecoded since the last decoded one
+	uint64_t skipped_packets;
 };
 
+static enum audio_format convert_sample_format(int format)
+{
+	switch (format) {
+	case AV_SAMPLE_FMT_U8:
+		return AUDIO_FORMAT_U8BIT;
+	case AV_SAMPLE_FMT_S16:
+		return AUDIO_FORMAT_16BIT;
+	case AV_SAMPLE_FMT_S32:
+		return AUDIO_FORMAT_32BIT;
+	case AV_SAMPLE_FMT_FLT:
+		return AUDIO_FORMAT_FLOAT;
+	case AV_SAMPLE_FMT_U8P:
+		return AUDIO_FORMAT_U8BIT_PLANAR;
+	case AV_SAMPLE_FMT_S16P:
+		return AUDIO_FORMAT_16BIT_PLANAR;
+	case AV_SAMPLE_FMT_S32P:
+		return AUDIO_FORMAT_32BIT_PLANAR;
+	case AV_SAMPLE_FMT_FLTP:
+		return AUDIO_FORMAT_FLOAT_PLANAR;
+	default:
+		return AUDIO_FORMAT_UNKNOWN;
+	}
+}
+
+static enum speaker_layout convert_speaker_layout(int channels)
+{
+	switch (channels) {
+	case 1:
+		return SPEAKERS_MONO;
+	case 2:
+		return SPEAKERS_STEREO;
+	case 3:
+		return SPEAKERS_2POINT1;
+	case 4:
+		return SPEAKERS_4POINT0;
+	case 5:
+		return SPEAKERS_4POINT1;
+	case 6:
+		return SPEAKERS_5POINT1;
+	case 8:
+		return SPEAKERS_7POINT1;
+	default:
+		return SPEAKERS_UNKNOWN;
+	}
+}
+
 bool audio_decoder_init(struct hang_source *context)
 {
+	return audio_decoder_init_codec(context, DEFAULT_AUDIO_CODEC, DEFAULT_AUDIO_SAMPLE_RATE,
+					DEFAULT_AUDIO_CHANNELS);
+}
+
+bool audio_decoder_init_codec(struct hang_source *context, const char *codec_name, uint32_t sample_rate,
+			      uint32_t channels)
+{
+	const AVCodec *codec = avcodec_find_decoder_by_name(codec_name);
+	if (!codec) {
+		obs_log(LOG_ERROR, "Audio codec %s not found", codec_name);
+		return false;
+	}
+
 	struct audio_decoder *decoder = bzalloc(sizeof(struct audio_decoder));
-	context->audio_decoder_context = decoder;
+	decoder->codec_ctx = avcodec_alloc_context3(codec);
+	decoder->packet = av_packet_alloc();
+	decoder->frame = av_frame_alloc();
+	if (!decoder->codec_ctx || !decoder->packet || !decoder->frame) {
+		obs_log(LOG_ERROR, "Failed to allocate audio decoder");
+		goto fail;
+	}
 
-	decoder->placeholder = 0;
+	// Packet timestamps are MoQ microseconds, and decoded frames carry them through
+	decoder->codec_ctx->sample_rate = (int)sample_rate;
+	decoder->codec_ctx->pkt_timebase = (AVRational){1, 1000000};
+	av_channel_layout_default(&decoder->codec_ctx->ch_layout, (int)channels);
 
-	obs_log(LOG_INFO, "Audio decoder placeholder initialized");
+	if (avcodec_open2(decoder->codec_ctx, codec, NULL) < 0) {
+		obs_log(LOG_ERROR, "Failed to open audio codec %s", codec_name);
+		goto fail;
+	}
+
+	decoder->codec_name = codec->name;
+	decoder->sample_rate = sample_rate;
+	decoder->channels = channels;
+	context->audio_decoder_context = decoder;
+	obs_log(LOG_INFO, "Audio decoder initialized: %s, %u Hz, %u channels", codec_name, sample_rate, channels);
 	return true;
+
+fail:
+	av_frame_free(&decoder->frame);
+	av_packet_free(&decoder->packet);
+	avcodec_free_context(&decoder->codec_ctx);
+	bfree(decoder);
+	return false;
+}
+
+bool audio_decoder_configure(struct hang_source *context, const char *codec, size_t codec_len, uint32_t sample_rate,
+			     uint32_t channels)
+{
+	const char *codec_name = NULL;
+	for (size_t i = 0; i < sizeof(catalog_codecs) / sizeof(catalog_codecs[0]); i++) {
+		if (strlen(catalog_codecs[i].catalog) == codec_len &&
+		    memcmp(catalog_codecs[i].catalog, codec, codec_len) == 0) {
+			codec_name = catalog_codecs[i].ffmpeg;
+			break;
+		}
+	}
+
+	// Decoding one codec's packets as another only makes noise; stay silent instead
+	if (!codec_name) {
+		obs_log(LOG_WARNING, "Unsupported audio codec in catalog: %.*s", (int)codec_len, codec);
+		audio_decoder_destroy(context);
+		return false;
+	}
+
+	if (sample_rate == 0) {
+		sample_rate = DEFAULT_AUDIO_SAMPLE_RATE;
+	}
+	if (channels == 0) {
+		channels = DEFAULT_AUDIO_CHANNELS;
+	}
+
+	const AVCodec *found = avcodec_find_decoder_by_name(codec_name);
+	struct audio_decoder *decoder = context->audio_decoder_context;
+	if (decoder && found && strcmp(decoder->codec_name, found->name) == 0 && decoder->sample_rate == sample_rate &&
+	    decoder->channels == channels) {
+		return true;
+	}
+
+	audio_decoder_destroy(context);
+	return audio_decoder_init_codec(context, codec_name, sample_rate, channels);
 }
 
 void audio_decoder_destroy(struct hang_source *context)
@@ -44,17 +205,128 @@ void audio_decoder_destroy(struct hang_source *context)
 		return;
 	}
 
+	av_frame_free(&decoder->frame);
+	av_packet_free(&decoder->packet);
+	avcodec_free_context(&decoder->codec_ctx);
 	bfree(decoder);
 	context->audio_decoder_context = NULL;
 }
 
+static void free_audio(struct obs_source_audio *audio)
+{
+	for (int ch = 0; ch < MAX_AV_PLANES && audio->data[ch]; ch++) {
+		bfree((void *)audio->data[ch]);
+	}
+	bfree(audio);
+}
+
+// Copy a decoded frame into the source's audio queue
+static bool queue_frame(struct hang_source *context, const AVFrame *frame, uint64_t timestamp_ns)
+{
+	enum audio_format format = convert_sample_format(frame->format);
+	enum speaker_layout speakers = convert_speaker_layout(frame->ch_layout.nb_channels);
+	if (format == AUDIO_FORMAT_UNKNOWN || speakers == SPEAKERS_UNKNOWN) {
+		obs_log(LOG_WARNING, "Unsupported audio format %d with %d channels", frame->format,
+			frame->ch_layout.nb_channels);
+		return false;
+	}
+
+	struct obs_source_audio *audio = bzalloc(sizeof(struct obs_source_audio));
+	audio->frames = (uint32_t)frame->nb_samples;
+	audio->speakers = speakers;
+	audio->format = format;
+	audio->samples_per_sec = (uint32_t)frame->sample_rate;
+	audio->timestamp = timestamp_ns;
+
+	size_t sample_size = (size_t)av_get_bytes_per_sample(frame->format);
+	bool planar = av_sample_fmt_is_planar(frame->format);
+	int planes = planar ? frame->ch_layout.nb_channels : 1;
+	size_t plane_size = sample_size * (size_t)frame->nb_samples * (planar ? 1 : frame->ch_layout.nb_channels);
+	for (int plane = 0; plane < planes && plane < MAX_AV_PLANES; plane++) {
+		uint8_t *data = bmalloc(plane_size);
+		memcpy(data, frame->data[plane], plane_size);
+		audio->data[plane] = data;
+	}
+
+	pthread_mutex_lock(&context->audio_mutex);
+	if (context->audio_queue_len == AUDIO_QUEUE_MAX) {
+		free_audio(context->audio_queue[0]);
+		memmove(context->audio_queue, context->audio_queue + 1,
+			sizeof(struct obs_source_audio *) * (context->audio_queue_len - 1));
+		context->audio_queue_len--;
+	}
+	if (context->audio_queue_len == context->audio_queue_cap) {
+		context->audio_queue_cap *= 2;
+		context->audio_queue =
+			brealloc(context->audio_queue, sizeof(struct obs_source_audio *) * context->audio_queue_cap);
+	}
+	context->audio_queue[context->audio_queue_len++] = audio;
+	pthread_mutex_unlock(&context->audio_mutex);
+	return true;
+}
+
 bool audio_decoder_decode(struct hang_source *context, const uint8_t *data, size_t size, uint64_t pts)
 {
-	UNUSED_PARAMETER(context);
-	UNUSED_PARAMETER(data);
-	UNUSED_PARAMETER(size);
-	UNUSED_PARAMETER(pts);
+	struct audio_decoder *decoder = context->audio_decoder_context;
 
-	// TODO: Implement FFmpeg audio decoding
-	return false;
+	// Coming back from skipped packets: what the codec still holds belongs to audio nobody
+	// heard, so start clean at this packet and take timing from it
+	if (decoder->skipped_packets > 0) {
+		avcodec_flush_buffers(decoder->codec_ctx);
+		obs_log(LOG_INFO, "Audio decode resumed after %llu skipped packets",
+			(unsigned long long)decoder->skipped_packets);
+		decoder->skipped_packets = 0;
+	}
+
+	decoder->packet->data = (uint8_t *)data;
+	decoder->packet->size = (int)size;
+	decoder->packet->pts = (int64_t)pts;
+
+	int ret = avcodec_send_packet(decoder->codec_ctx, decoder->packet);
+	decoder->packet->data = NULL;
+	decoder->packet->size = 0;
+	if (ret < 0) {
+		obs_log(LOG_WARNING, "Failed to send audio packet: %d", ret);
+		return false;
+	}
+
+	// Frames carry their packet's timestamp; any further frames from one packet follow on by samples
+	bool queued = false;
+	uint64_t next_ns = pts * 1000;
+	while (avcodec_receive_frame(decoder->codec_ctx, decoder->frame) == 0) {
+		uint64_t timestamp_ns = decoder->frame->pts != AV_NOPTS_VALUE ? (uint64_t)decoder->frame->pts * 1000
+									       : next_ns;
+		if (queue_frame(context, decoder->frame, timestamp_ns)) {
+			queued = true;
+		}
+		if (decoder->frame->sample_rate > 0) {
+			next_ns = timestamp_ns +
+				  (uint64_t)decoder->frame->nb_samples * 1000000000ULL / (uint64_t)decoder->frame->sample_rate;
+		}
+		av_frame_unref(decoder->frame);
+	}
+
+	return queued;
+}
+
+// Nobody can hear the source: drop the packet undecoded. The next decoded packet flushes
+// the codec and takes its own timestamp, so nothing else is needed to resume in sync.
+void audio_decoder_skip(struct hang_source *context)
+{
+	struct audio_decoder *decoder = context->audio_decoder_context;
+
+	if (decoder->skipped_packets++ == 0) {
+		obs_log(LOG_INFO, "Audio muted and unmonitored, skipping decode");
+	}
+}
+
+void audio_decoder_output(struct hang_source *context)
+{
+	pthread_mutex_lock(&context->audio_mutex);
+	for (size_t i = 0; i < context->audio_queue_len; i++) {
+		obs_source_output_audio(context->source, context->audio_queue[i]);
+		free_audio(context->audio_queue[i]);
+	}
+	context->audio_queue_len = 0;
+	pthread_mutex_unlock(&context->audio_mutex);
 }
@@ -19,6 +19,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <obs-module.h>
 
@@ -26,5 +27,16 @@ struct hang_source;
 
 // Audio decoder functions
 bool audio_decoder_init(struct hang_source *context);
+// Decoder for a specific FFmpeg codec, for streams that are not the default Opus
+bool audio_decoder_init_codec(struct hang_source *context, const char *codec_name, uint32_t sample_rate,
+			      uint32_t channels);
+// Reopen the decoder for a catalog's audio track, given its WebCodecs codec string;
+// zero rate or channels keep the defaults. Nothing changes if it already matches.
+bool audio_decoder_configure(struct hang_source *context, const char *codec, size_t codec_len, uint32_t sample_rate,
+			     uint32_t channels);
 void audio_decoder_destroy(struct hang_source *context);
+// Decode a packet into the source's audio queue; pts is in microseconds
 bool audio_decoder_decode(struct hang_source *context, const uint8_t *data, size_t size, uint64_t pts);
+void audio_decoder_skip(struct hang_source *context);
+// Hand queued audio to OBS
+void audio_decoder_output(struct hang_source *context);
@@ -0,0 +1,511 @@
+/*
+Bandwidth Allocator for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_FRONTEND_API
+#include <obs-frontend-api.h>
+#endif
+
+#include "hang-source.h"
+#include "bandwidth-allocator.h"
+
+// How often throughput is measured and ceilings are handed out
+#define ALLOCATOR_INTERVAL_MS 1000
+// On congestion the link estimate drops to this share of what was delivered
+#define CAPACITY_BACKOFF_PERCENT 85
+// Further back-offs wait this long, so one congestion episode only counts once
+#define CAPACITY_BACKOFF_HOLD_NS 3000000000ULL
+// The estimate stays at or below the rate that last congested for this many back-off holds
+#define CAPACITY_CONGESTED_HOLDS 10
+// Each healthy interval in which sources deliver this share of what they were allotted
+// probes this much more capacity
+#define CAPACITY_PROBE_USED_PERCENT 80
+#define CAPACITY_PROBE_KBPS 200
+// Limits are lifted once every shown source has had its best rendition for this long,
+// with this much headroom over what they all want
+#define CAPACITY_LIFT_HOLD_NS 30000000000ULL
+#define CAPACITY_LIFT_HEADROOM_PERCENT 125
+// Never squeeze the estimate below this
+#define CAPACITY_MIN_KBPS 300
+
+// A source gets a higher rendition at most this often; lower ones apply at once
+#define UPGRADE_HOLD_NS 10000000000ULL
+
+// A source is congested when this share of its frames went missing in an interval,
+#define CONGESTION_LOSS_PERCENT 2
+// when the congestion policy finds either track behind its windowed baseline,
+// or when its video delivers under this share of the rendition's catalog bitrate for a
+// few intervals in a row (catalog bitrates are averages, so one quiet second is normal)
+#define SHORTFALL_PERCENT 50
+#define SHORTFALL_INTERVALS 3
+
+struct allocator_entry {
+	struct hang_source *context;
+	uint64_t last_bytes;
+	uint64_t last_video_frames;
+	uint64_t last_frames;
+	uint64_t last_lost;
+	uint32_t shortfall_intervals;
+	long ceiling_kbps;
+	long granted_kbps;       // Bitrate of the rendition the last pass allowed
+	uint64_t last_upgrade_ns; // When granted_kbps last went up
+
+	// Filled in for the current pass
+	long throughput_kbps;
+	enum bandwidth_priority priority;
+	struct video_rendition renditions[MAX_VIDEO_RENDITIONS];
+	size_t rendition_count;
+	size_t level; // Position in renditions, sorted by bitrate
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	struct allocator_entry *entries;
+	size_t entries_len;
+	size_t entries_cap;
+
+	bool running;
+	pthread_t thread;
+	os_event_t *stop_event;
+
+	long throughput_kbps; // Smoothed total delivered across all sources
+	long capacity_kbps;   // Link estimate; 0 until congestion has been seen
+	long congested_kbps;  // Throughput when congestion was last seen
+	uint64_t last_backoff_ns;
+	long allotted_kbps;       // What the last pass handed out
+	uint64_t covered_since_ns; // Since every shown source has its best rendition, 0 if not
+
+	obs_weak_source_t *preview_scene; // Studio mode preview, if any
+} alloc = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+size_t bandwidth_select_rendition(const struct video_rendition *renditions, size_t count, long ceiling_kbps)
+{
+	// No bitrates known: keep the catalog's first track
+	if (count == 0 || renditions[count - 1].bitrate_kbps == 0) {
+		return 0;
+	}
+	if (ceiling_kbps <= 0) {
+		return count - 1;
+	}
+
+	size_t best = 0;
+	for (size_t i = 1; i < count; i++) {
+		if (renditions[i].bitrate_kbps <= ceiling_kbps) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Caller holds alloc.mutex
+static bool in_preview_scene(obs_source_t *source)
+{
+	obs_source_t *scene_source = obs_weak_source_get_source(alloc.preview_scene);
+	if (!scene_source) {
+		return false;
+	}
+
+	obs_scene_t *scene = obs_scene_from_source(scene_source);
+	bool found = scene && obs_scene_find_source_recursive(scene, obs_source_get_name(source)) != NULL;
+	obs_source_release(scene_source);
+	return found;
+}
+
+static enum bandwidth_priority source_priority(struct hang_source *context)
+{
+	if (obs_source_active(context->source)) {
+		return BANDWIDTH_PRIORITY_PROGRAM;
+	}
+	if (!obs_source_showing(context->source)) {
+		return BANDWIDTH_PRIORITY_HIDDEN;
+	}
+	// Showing but not on program: the studio mode preview, a projector or the multiview
+	if (in_preview_scene(context->source)) {
+		return BANDWIDTH_PRIORITY_PREVIEW;
+	}
+	return BANDWIDTH_PRIORITY_VISIBLE;
+}
+
+static bool entry_has_bitrates(const struct allocator_entry *entry)
+{
+	return entry->rendition_count > 0 && entry->renditions[entry->rendition_count - 1].bitrate_kbps > 0;
+}
+
+// Cost of a source at its current level; sources without known bitrates cost what they deliver
+static long entry_cost_kbps(const struct allocator_entry *entry)
+{
+	return entry_has_bitrates(entry) ? entry->renditions[entry->level].bitrate_kbps : entry->throughput_kbps;
+}
+
+static bool entry_can_upgrade(const struct allocator_entry *entry)
+{
+	return entry_has_bitrates(entry) && entry->level + 1 < entry->rendition_count;
+}
+
+// Counters restart when a source reactivates
+static uint64_t counter_delta(uint64_t now, uint64_t last)
+{
+	return now >= last ? now - last : now;
+}
+
+// Whether a source's own delivery says the link is short, whether or not it sheds video
+// itself: frames going missing, frames arriving late, or video well under the bitrate of
+// the rendition it is subscribed to
+static bool entry_congested(struct allocator_entry *entry, const struct congestion_policy *congestion,
+			    size_t selected, uint64_t now_ns)
+{
+	bool congested = congestion->state != CONGESTION_STATE_NORMAL;
+
+	uint64_t video_frames = congestion->video.frames_received;
+	uint64_t frames = video_frames + congestion->audio.frames_received;
+	uint64_t lost = congestion->video.frames_lost + congestion->audio.frames_lost;
+	uint64_t new_video_frames = counter_delta(video_frames, entry->last_video_frames);
+	uint64_t new_frames = counter_delta(frames, entry->last_frames);
+	uint64_t new_lost = counter_delta(lost, entry->last_lost);
+	entry->last_video_frames = video_frames;
+	entry->last_frames = frames;
+	entry->last_lost = lost;
+
+	if (new_lost > 0 && new_lost * 100 >= (new_frames + new_lost) * CONGESTION_LOSS_PERCENT) {
+		congested = true;
+	}
+	if (congestion_policy_late(congestion, now_ns)) {
+		congested = true;
+	}
+
+	bool shortfall = false;
+	if (entry_has_bitrates(entry) && new_video_frames > 0 && selected < entry->rendition_count) {
+		long expected_kbps = entry->renditions[selected].bitrate_kbps;
+		shortfall = entry->throughput_kbps * 100 < expected_kbps * SHORTFALL_PERCENT;
+	}
+	entry->shortfall_intervals = shortfall ? entry->shortfall_intervals + 1 : 0;
+	if (entry->shortfall_intervals >= SHORTFALL_INTERVALS) {
+		congested = true;
+	}
+
+	return congested;
+}
+
+// Caller holds alloc.mutex
+static void measure(uint64_t now_ns, double seconds)
+{
+	long total_kbps = 0;
+	bool congested = false;
+
+	for (size_t i = 0; i < alloc.entries_len; i++) {
+		struct allocator_entry *entry = &alloc.entries[i];
+		struct hang_source *context = entry->context;
+
+		pthread_mutex_lock(&context->decoder_mutex);
+		uint64_t bytes = context->bytes_received;
+		struct congestion_policy congestion = context->congestion;
+		size_t selected = context->rendition_selected;
+		entry->rendition_count = context->rendition_count;
+		memcpy(entry->renditions, context->renditions, sizeof(entry->renditions));
+		pthread_mutex_unlock(&context->decoder_mutex);
+
+		uint64_t delta = bytes - entry->last_bytes;
+		entry->last_bytes = bytes;
+		entry->throughput_kbps = (long)((double)delta * 8.0 / 1000.0 / seconds);
+		entry->priority = source_priority(context);
+		entry->level = 0;
+
+		if (entry_congested(entry, &congestion, selected, now_ns)) {
+			congested = true;
+		}
+
+		total_kbps += entry->throughput_kbps;
+	}
+
+	alloc.throughput_kbps = alloc.throughput_kbps ? (alloc.throughput_kbps * 3 + total_kbps) / 4 : total_kbps;
+
+	if (congested) {
+		// Delivery fell behind somewhere: what got through is the best guess at the link
+		if (now_ns - alloc.last_backoff_ns < CAPACITY_BACKOFF_HOLD_NS) {
+			return;
+		}
+		long capacity = alloc.throughput_kbps * CAPACITY_BACKOFF_PERCENT / 100;
+		if (capacity < CAPACITY_MIN_KBPS) {
+			capacity = CAPACITY_MIN_KBPS;
+		}
+		if (!alloc.capacity_kbps || capacity < alloc.capacity_kbps) {
+			obs_log(LOG_INFO, "Bandwidth: congestion at %ld kbps delivered, limiting to %ld kbps",
+				alloc.throughput_kbps, capacity);
+			alloc.capacity_kbps = capacity;
+		}
+		alloc.congested_kbps = alloc.throughput_kbps;
+		alloc.last_backoff_ns = now_ns;
+		alloc.covered_since_ns = 0;
+		return;
+	}
+
+	// Probe only when sources carry what they were given; a link that is not even
+	// delivering that says nothing about room for more
+	if (!alloc.capacity_kbps || alloc.throughput_kbps * 100 < alloc.allotted_kbps * CAPACITY_PROBE_USED_PERCENT) {
+		return;
+	}
+
+	long capacity = alloc.capacity_kbps + CAPACITY_PROBE_KBPS;
+	if (now_ns - alloc.last_backoff_ns < CAPACITY_BACKOFF_HOLD_NS * CAPACITY_CONGESTED_HOLDS &&
+	    capacity > alloc.congested_kbps) {
+		capacity = alloc.congested_kbps > alloc.capacity_kbps ? alloc.congested_kbps : alloc.capacity_kbps;
+	}
+	alloc.capacity_kbps = capacity;
+}
+
+// Caller holds alloc.mutex
+static void allocate(uint64_t now_ns)
+{
+	long demand_kbps = 0;
+	long budget_kbps = alloc.capacity_kbps;
+
+	for (size_t i = 0; i < alloc.entries_len; i++) {
+		struct allocator_entry *entry = &alloc.entries[i];
+
+		// Everyone starts at their lowest rendition
+		budget_kbps -= entry_cost_kbps(entry);
+
+		if (entry->priority != BANDWIDTH_PRIORITY_HIDDEN && entry_can_upgrade(entry)) {
+			demand_kbps += entry->renditions[entry->rendition_count - 1].bitrate_kbps;
+		} else {
+			demand_kbps += entry_cost_kbps(entry);
+		}
+	}
+
+	// The probe has covered what every shown source wants, with headroom, for a while and
+	// well past the last congestion: lift the limit
+	if (alloc.capacity_kbps && alloc.covered_since_ns && now_ns - alloc.covered_since_ns >= CAPACITY_LIFT_HOLD_NS &&
+	    now_ns - alloc.last_backoff_ns >= CAPACITY_BACKOFF_HOLD_NS * CAPACITY_CONGESTED_HOLDS &&
+	    alloc.capacity_kbps * 100 >= demand_kbps * CAPACITY_LIFT_HEADROOM_PERCENT) {
+		obs_log(LOG_INFO, "Bandwidth: %ld kbps covers all sources, removing limits", alloc.capacity_kbps);
+		alloc.capacity_kbps = 0;
+		alloc.covered_since_ns = 0;
+	}
+
+	for (enum bandwidth_priority priority = BANDWIDTH_PRIORITY_PROGRAM; priority < BANDWIDTH_PRIORITY_HIDDEN;
+	     priority++) {
+		// Raise sources of this priority one step at a time so they share what is left
+		bool upgraded = true;
+		while (upgraded) {
+			upgraded = false;
+			for (size_t i = 0; i < alloc.entries_len; i++) {
+				struct allocator_entry *entry = &alloc.entries[i];
+				if (entry->priority != priority || !entry_can_upgrade(entry)) {
+					continue;
+				}
+
+				long next_kbps = entry->renditions[entry->level + 1].bitrate_kbps;
+				long step_kbps = next_kbps - entry->renditions[entry->level].bitrate_kbps;
+				if (alloc.capacity_kbps && step_kbps > budget_kbps) {
+					continue;
+				}
+
+				// Upgrades are held apart, so a probe cannot switch a source up and down
+				// every interval
+				if (alloc.capacity_kbps && next_kbps > entry->granted_kbps &&
+				    now_ns - entry->last_upgrade_ns < UPGRADE_HOLD_NS) {
+					continue;
+				}
+
+				entry->level++;
+				budget_kbps -= step_kbps;
+				upgraded = true;
+			}
+		}
+	}
+
+	bool covered = true;
+	alloc.allotted_kbps = 0;
+	for (size_t i = 0; i < alloc.entries_len; i++) {
+		struct allocator_entry *entry = &alloc.entries[i];
+
+		if (entry->priority != BANDWIDTH_PRIORITY_HIDDEN && entry_can_upgrade(entry)) {
+			covered = false;
+		}
+		alloc.allotted_kbps += entry_cost_kbps(entry);
+
+		if (entry_has_bitrates(entry)) {
+			long granted_kbps = entry->renditions[entry->level].bitrate_kbps;
+			if (granted_kbps > entry->granted_kbps) {
+				entry->last_upgrade_ns = now_ns;
+			}
+			entry->granted_kbps = granted_kbps;
+		}
+
+		// Unlimited unless squeezed; hidden sources always take the cheapest rendition
+		long ceiling_kbps = 0;
+		if (entry_has_bitrates(entry)) {
+			ceiling_kbps = entry->renditions[entry->level].bitrate_kbps;
+			if (!alloc.capacity_kbps && entry->priority != BANDWIDTH_PRIORITY_HIDDEN) {
+				ceiling_kbps = 0;
+			}
+		}
+
+		if (ceiling_kbps != entry->ceiling_kbps) {
+			entry->ceiling_kbps = ceiling_kbps;
+			hang_source_set_rendition_ceiling(entry->context, ceiling_kbps);
+		}
+	}
+
+	if (!covered || !alloc.capacity_kbps) {
+		alloc.covered_since_ns = 0;
+	} else if (!alloc.covered_since_ns) {
+		alloc.covered_since_ns = now_ns;
+	}
+}
+
+static void *allocator_thread(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("hang-bandwidth-allocator");
+
+	uint64_t last_ns = os_gettime_ns();
+	while (os_event_timedwait(alloc.stop_event, ALLOCATOR_INTERVAL_MS) == ETIMEDOUT) {
+		uint64_t now_ns = os_gettime_ns();
+		double seconds = (double)(now_ns - last_ns) / 1e9;
+		last_ns = now_ns;
+
+		pthread_mutex_lock(&alloc.mutex);
+		measure(now_ns, seconds);
+		allocate(now_ns);
+		pthread_mutex_unlock(&alloc.mutex);
+	}
+
+	return NULL;
+}
+
+#ifdef HAVE_FRONTEND_API
+static void update_preview_scene(bool exiting)
+{
+	obs_weak_source_t *weak = NULL;
+	if (!exiting && obs_frontend_preview_program_mode_active()) {
+		obs_source_t *scene = obs_frontend_get_current_preview_scene();
+		weak = obs_source_get_weak_source(scene);
+		obs_source_release(scene);
+	}
+
+	pthread_mutex_lock(&alloc.mutex);
+	obs_weak_source_release(alloc.preview_scene);
+	alloc.preview_scene = weak;
+	pthread_mutex_unlock(&alloc.mutex);
+}
+
+static void on_frontend_event(enum obs_frontend_event event, void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	switch (event) {
+	case OBS_FRONTEND_EVENT_FINISHED_LOADING:
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_ENABLED:
+	case OBS_FRONTEND_EVENT_STUDIO_MODE_DISABLED:
+	case OBS_FRONTEND_EVENT_PREVIEW_SCENE_CHANGED:
+		update_preview_scene(false);
+		break;
+	case OBS_FRONTEND_EVENT_EXIT:
+		update_preview_scene(true);
+		break;
+	default:
+		break;
+	}
+}
+#endif
+
+void bandwidth_allocator_start(void)
+{
+	if (os_event_init(&alloc.stop_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		obs_log(LOG_ERROR, "Failed to create bandwidth allocator event");
+		return;
+	}
+
+	if (pthread_create(&alloc.thread, NULL, allocator_thread, NULL) != 0) {
+		obs_log(LOG_ERROR, "Failed to start bandwidth allocator thread");
+		os_event_destroy(alloc.stop_event);
+		alloc.stop_event = NULL;
+		return;
+	}
+	alloc.running = true;
+
+#ifdef HAVE_FRONTEND_API
+	obs_frontend_add_event_callback(on_frontend_event, NULL);
+#endif
+}
+
+void bandwidth_allocator_stop(void)
+{
+#ifdef HAVE_FRONTEND_API
+	if (alloc.running) {
+		obs_frontend_remove_event_callback(on_frontend_event, NULL);
+	}
+#endif
+
+	if (alloc.running) {
+		os_event_signal(alloc.stop_event);
+		pthread_join(alloc.thread, NULL);
+		alloc.running = false;
+	}
+
+	if (alloc.stop_event) {
+		os_event_destroy(alloc.stop_event);
+		alloc.stop_event = NULL;
+	}
+
+	obs_weak_source_release(alloc.preview_scene);
+	alloc.preview_scene = NULL;
+
+	bfree(alloc.entries);
+	alloc.entries = NULL;
+	alloc.entries_len = 0;
+	alloc.entries_cap = 0;
+	alloc.throughput_kbps = 0;
+	alloc.capacity_kbps = 0;
+	alloc.congested_kbps = 0;
+	alloc.last_backoff_ns = 0;
+	alloc.allotted_kbps = 0;
+	alloc.covered_since_ns = 0;
+}
+
+void bandwidth_allocator_add_source(struct hang_source *context)
+{
+	pthread_mutex_lock(&alloc.mutex);
+	if (alloc.entries_len == alloc.entries_cap) {
+		alloc.entries_cap = alloc.entries_cap ? alloc.entries_cap * 2 : 16;
+		alloc.entries = brealloc(alloc.entries, sizeof(struct allocator_entry) * alloc.entries_cap);
+	}
+	struct allocator_entry *entry = &alloc.entries[alloc.entries_len++];
+	memset(entry, 0, sizeof(*entry));
+	entry->context = context;
+	pthread_mutex_unlock(&alloc.mutex);
+}
+
+void bandwidth_allocator_remove_source(struct hang_source *context)
+{
+	pthread_mutex_lock(&alloc.mutex);
+	for (size_t i = 0; i < alloc.entries_len; i++) {
+		if (alloc.entries[i].context == context) {
+			alloc.entries[i] = alloc.entries[--alloc.entries_len];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&alloc.mutex);
+}
@@ -0,0 +1,54 @@
+/*
+Bandwidth Allocator for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct hang_source;
+
+// Most video tracks a catalog can offer for selection
+#define MAX_VIDEO_RENDITIONS 8
+
+// One selectable video track from the catalog
+struct video_rendition {
+	uint32_t index; // Track index for moq_consume_video_track
+	uint32_t width;
+	uint32_t height;
+	long bitrate_kbps; // From the catalog, or estimated from the coded size
+};
+
+// Who gets bandwidth first, from on air to not shown anywhere
+enum bandwidth_priority {
+	BANDWIDTH_PRIORITY_PROGRAM,
+	BANDWIDTH_PRIORITY_PREVIEW,
+	BANDWIDTH_PRIORITY_VISIBLE,
+	BANDWIDTH_PRIORITY_HIDDEN,
+	BANDWIDTH_PRIORITY_COUNT,
+};
+
+// Plugin-wide bandwidth manager: measures delivered throughput across all sources and
+// hands out per-source rendition ceilings by priority
+void bandwidth_allocator_start(void);
+void bandwidth_allocator_stop(void);
+void bandwidth_allocator_add_source(struct hang_source *context);
+void bandwidth_allocator_remove_source(struct hang_source *context);
+
+// Best rendition under a ceiling (0 = unlimited); renditions are sorted by bitrate
+size_t bandwidth_select_rendition(const struct video_rendition *renditions, size_t count, long ceiling_kbps);
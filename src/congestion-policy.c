@@ -0,0 +1,221 @@
+/*
+Audio-First Congestion Policy for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <string.h>
+
+#include "congestion-policy.h"
+
+// A track is in deficit once it falls this far behind its best observed delivery
+#define AUDIO_LATE_THRESHOLD_US 250000
+#define VIDEO_LATE_THRESHOLD_US 500000
+// No video at all for this long while audio still arrives is also a deficit
+#define VIDEO_STALL_THRESHOLD_NS 1000000000ULL
+// Lateness of a track that has delivered nothing for this long says nothing about the link now
+#define LATENESS_STALE_NS 2000000000ULL
+
+// How long a deficit must last before video is dropped
+#define STEP_DOWN_HOLD_NS 2000000000ULL
+// Healthy time before probing video again, doubled after each failed probe
+#define RECOVER_HOLD_MIN_NS 5000000000ULL
+#define RECOVER_HOLD_MAX_NS 60000000000ULL
+// Full video must stay healthy this long before the probe backoff is forgotten
+#define BACKOFF_RESET_NS 30000000000ULL
+
+// Length of one slot of the baseline history
+#define BASE_MINUTE_NS 60000000000ULL
+
+static void track_loss_update(struct congestion_track_stats *stats, uint64_t timestamp_us)
+{
+	stats->frames_received++;
+	stats->frames_lost += frame_gap_push(&stats->gap, timestamp_us);
+}
+
+// The baseline is the smallest offset of the last few minutes rather than of all time. The
+// publisher's clock drifts against ours, which a fixed minimum would read as ever-growing
+// lateness; a queue that stays long for the whole history is also accepted as the new normal.
+static void track_baseline_update(struct congestion_track_stats *stats, int64_t offset_us, uint64_t now_ns)
+{
+	if (!stats->has_baseline) {
+		for (size_t i = 0; i < CONGESTION_BASE_HISTORY; i++) {
+			stats->base_history_us[i] = offset_us;
+		}
+		stats->base_index = 0;
+		stats->base_minute_start_ns = now_ns;
+		stats->baseline_offset_us = offset_us;
+		stats->has_baseline = true;
+		return;
+	}
+
+	if (now_ns - stats->base_minute_start_ns >= BASE_MINUTE_NS) {
+		// Start a new minute, forgetting the oldest one
+		stats->base_index = (stats->base_index + 1) % CONGESTION_BASE_HISTORY;
+		stats->base_history_us[stats->base_index] = offset_us;
+		stats->base_minute_start_ns = now_ns;
+
+		stats->baseline_offset_us = offset_us;
+		for (size_t i = 0; i < CONGESTION_BASE_HISTORY; i++) {
+			if (stats->base_history_us[i] < stats->baseline_offset_us) {
+				stats->baseline_offset_us = stats->base_history_us[i];
+			}
+		}
+		return;
+	}
+
+	if (offset_us < stats->base_history_us[stats->base_index]) {
+		stats->base_history_us[stats->base_index] = offset_us;
+	}
+	if (offset_us < stats->baseline_offset_us) {
+		stats->baseline_offset_us = offset_us;
+	}
+}
+
+// Behind the windowed baseline by more than the threshold, as of a recent delivery
+static bool track_late(const struct congestion_track_stats *stats, int64_t threshold_us, uint64_t now_ns)
+{
+	return stats->has_baseline && stats->lateness_us > threshold_us &&
+	       now_ns - stats->last_arrival_ns < LATENESS_STALE_NS;
+}
+
+static void track_stats_update(struct congestion_track_stats *stats, uint64_t timestamp_us, uint64_t now_ns)
+{
+	int64_t offset_us = (int64_t)(now_ns / 1000) - (int64_t)timestamp_us;
+
+	track_baseline_update(stats, offset_us, now_ns);
+
+	// Smooth over ~8 frames so a single burst doesn't trigger a stage change
+	int64_t sample_us = offset_us - stats->baseline_offset_us;
+	stats->lateness_us += (sample_us - stats->lateness_us) / 8;
+	stats->last_arrival_ns = now_ns;
+
+	track_loss_update(stats, timestamp_us);
+}
+
+void congestion_policy_reset(struct congestion_policy *policy, bool enabled)
+{
+	memset(policy, 0, sizeof(*policy));
+	policy->enabled = enabled;
+	policy->state = CONGESTION_STATE_NORMAL;
+	policy->recover_hold_ns = RECOVER_HOLD_MIN_NS;
+	frame_gap_reset(&policy->video.gap, FRAME_GAP_VIDEO_REORDER);
+	frame_gap_reset(&policy->audio.gap, 0);
+}
+
+void congestion_policy_video_track_changed(struct congestion_policy *policy)
+{
+	// A new subscription joins mid-stream, so the step from the old track's last frame is no loss
+	frame_gap_reset(&policy->video.gap, FRAME_GAP_VIDEO_REORDER);
+}
+
+bool congestion_policy_on_video_frame(struct congestion_policy *policy, uint64_t timestamp_us, uint64_t now_ns)
+{
+	track_stats_update(&policy->video, timestamp_us, now_ns);
+
+	// Frames still in flight when the subscription closed are not worth decoding
+	return !policy->enabled || policy->state == CONGESTION_STATE_NORMAL;
+}
+
+enum congestion_action congestion_policy_on_audio_frame(struct congestion_policy *policy, uint64_t timestamp_us,
+							uint64_t now_ns)
+{
+	track_stats_update(&policy->audio, timestamp_us, now_ns);
+
+	if (!policy->enabled) {
+		return CONGESTION_ACTION_NONE;
+	}
+
+	// Audio is the reference: if it keeps arriving on time, the link can carry it
+	bool deficit = track_late(&policy->audio, AUDIO_LATE_THRESHOLD_US, now_ns);
+	if (policy->state != CONGESTION_STATE_AUDIO_ONLY) {
+		if (track_late(&policy->video, VIDEO_LATE_THRESHOLD_US, now_ns)) {
+			deficit = true;
+		}
+		if (policy->video.last_arrival_ns > 0 &&
+		    now_ns - policy->video.last_arrival_ns > VIDEO_STALL_THRESHOLD_NS) {
+			deficit = true;
+		}
+	}
+
+	if (deficit) {
+		policy->healthy_since_ns = 0;
+		if (policy->deficit_since_ns == 0) {
+			policy->deficit_since_ns = now_ns;
+		}
+		if (now_ns - policy->deficit_since_ns < STEP_DOWN_HOLD_NS) {
+			return CONGESTION_ACTION_NONE;
+		}
+
+		policy->deficit_since_ns = now_ns;
+		if (policy->state == CONGESTION_STATE_AUDIO_ONLY) {
+			// Audio itself is late; there is nothing left to shed. If the delay stays,
+			// the baseline takes it in within the base history and video is probed again.
+			return CONGESTION_ACTION_NONE;
+		}
+
+		// Skipping frames that were already downloaded frees no capacity, so go
+		// straight to unsubscribing video
+		policy->state = CONGESTION_STATE_AUDIO_ONLY;
+		obs_log(LOG_WARNING, "Sustained delivery deficit, dropping video to protect audio");
+		return CONGESTION_ACTION_DROP_VIDEO;
+	}
+
+	policy->deficit_since_ns = 0;
+	if (policy->healthy_since_ns == 0) {
+		policy->healthy_since_ns = now_ns;
+	}
+	uint64_t healthy_ns = now_ns - policy->healthy_since_ns;
+
+	if (policy->state == CONGESTION_STATE_NORMAL) {
+		if (healthy_ns >= BACKOFF_RESET_NS) {
+			policy->recover_hold_ns = RECOVER_HOLD_MIN_NS;
+		}
+		return CONGESTION_ACTION_NONE;
+	}
+
+	if (healthy_ns < policy->recover_hold_ns) {
+		return CONGESTION_ACTION_NONE;
+	}
+
+	// Probe with full video; a failed probe waits twice as long next time
+	policy->state = CONGESTION_STATE_NORMAL;
+	policy->recover_hold_ns *= 2;
+	if (policy->recover_hold_ns > RECOVER_HOLD_MAX_NS) {
+		policy->recover_hold_ns = RECOVER_HOLD_MAX_NS;
+	}
+	policy->healthy_since_ns = now_ns;
+
+	// The new subscription gets a fresh baseline, and a stall is timed from now
+	memset(&policy->video, 0, sizeof(policy->video));
+	frame_gap_reset(&policy->video.gap, FRAME_GAP_VIDEO_REORDER);
+	policy->video.last_arrival_ns = now_ns;
+
+	obs_log(LOG_INFO, "Audio delivery healthy, restoring video subscription");
+	return CONGESTION_ACTION_RESTORE_VIDEO;
+}
+
+// Whether delivery is behind right now, by the thresholds and windowed baseline the policy
+// itself uses. Video that was dropped, and tracks that went quiet, are not counted.
+bool congestion_policy_late(const struct congestion_policy *policy, uint64_t now_ns)
+{
+	if (track_late(&policy->audio, AUDIO_LATE_THRESHOLD_US, now_ns)) {
+		return true;
+	}
+	return policy->state != CONGESTION_STATE_AUDIO_ONLY &&
+	       track_late(&policy->video, VIDEO_LATE_THRESHOLD_US, now_ns);
+}
@@ -0,0 +1,79 @@
+/*
+Audio-First Congestion Policy for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame-gap.h"
+
+// Degradation stages, from healthy to audio-only
+enum congestion_state {
+	CONGESTION_STATE_NORMAL,
+	CONGESTION_STATE_AUDIO_ONLY,
+};
+
+// Subscription change the caller must apply to the video track
+enum congestion_action {
+	CONGESTION_ACTION_NONE,
+	CONGESTION_ACTION_DROP_VIDEO,
+	CONGESTION_ACTION_RESTORE_VIDEO,
+};
+
+// Minutes of delivery history the baseline is taken from
+#define CONGESTION_BASE_HISTORY 10
+
+// Per-track delivery tracking
+struct congestion_track_stats {
+	bool has_baseline;
+	int64_t baseline_offset_us; // Smallest (arrival - media timestamp) over the base history
+	int64_t lateness_us;        // Smoothed delay behind the baseline
+
+	// Smallest offset of each recent minute, so the baseline follows publisher clock drift
+	int64_t base_history_us[CONGESTION_BASE_HISTORY];
+	uint32_t base_index;
+	uint64_t base_minute_start_ns;
+
+	uint64_t last_arrival_ns;
+
+	// Loss, from holes in the presentation-order timestamps
+	struct frame_gap gap;
+	uint64_t frames_received;
+	uint64_t frames_lost;
+};
+
+struct congestion_policy {
+	bool enabled;
+	enum congestion_state state;
+
+	struct congestion_track_stats video;
+	struct congestion_track_stats audio;
+
+	uint64_t deficit_since_ns; // Start of the current deficit, 0 while healthy
+	uint64_t healthy_since_ns; // Start of the current healthy run, 0 while in deficit
+	uint64_t recover_hold_ns;  // Healthy time required before video is probed again
+};
+
+// Congestion policy functions
+void congestion_policy_reset(struct congestion_policy *policy, bool enabled);
+void congestion_policy_video_track_changed(struct congestion_policy *policy);
+bool congestion_policy_on_video_frame(struct congestion_policy *policy, uint64_t timestamp_us, uint64_t now_ns);
+enum congestion_action congestion_policy_on_audio_frame(struct congestion_policy *policy, uint64_t timestamp_us,
+							uint64_t now_ns);
+bool congestion_policy_late(const struct congestion_policy *policy, uint64_t now_ns);
@@ -0,0 +1,466 @@
+/*
+Out-of-Process Decode Host Client for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// memfd_create
+#define _GNU_SOURCE
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hang-source.h"
+#include "nvdec-decoder.h"
+#include "decode-host-client.h"
+#include "decode-host-protocol.h"
+
+extern char **environ;
+
+// Give up on a host that keeps crashing: this many restarts within the window
+#define RESTART_LIMIT 5
+#define RESTART_WINDOW_NS 10000000000ULL
+
+struct decode_host_client {
+	struct hang_source *context;
+	bool conceal_errors;
+	char *helper_path;
+
+	// Shared memory, mapped in both processes
+	int shm_fd;
+	uint8_t *base;
+	size_t slot_size;
+	size_t shm_size;
+	struct decode_host_shm *shm;
+
+	// Helper process and its wake-up socket
+	pid_t pid;
+	int sock;
+	pthread_mutex_t lock; // Serializes submits against restarts
+
+	pthread_t reader_thread;
+	bool reader_running;
+	atomic_bool stopping;
+	atomic_bool resync;
+	bool failed;
+
+	// Reader thread state
+	unsigned int front; // Slot currently shown by the source
+	uint32_t corrupt_frames;
+	uint64_t restart_window_start_ns;
+	uint32_t restarts;
+};
+
+static void *reader_thread_main(void *data);
+
+static char *find_helper_path(void)
+{
+	const char *module_path = obs_get_module_binary_path(obs_current_module());
+	if (!module_path) {
+		return NULL;
+	}
+
+	// The helper is installed next to the plugin binary
+	const char *slash = strrchr(module_path, '/');
+	size_t dir_len = slash ? (size_t)(slash - module_path) : 0;
+	size_t size = dir_len + 1 + strlen(DECODE_HOST_EXECUTABLE) + 1;
+
+	char *path = bzalloc(size);
+	snprintf(path, size, "%.*s/%s", (int)dir_len, module_path, DECODE_HOST_EXECUTABLE);
+	return path;
+}
+
+// Size the shared region for slots of at least slot_size bytes and map it. The old
+// mapping, if any, stays valid until the new one is in place.
+static bool map_shared(struct decode_host_client *client, size_t slot_size)
+{
+	slot_size = (slot_size + 4095) & ~(size_t)4095;
+	size_t shm_size = decode_host_shm_size(slot_size);
+
+	if (ftruncate(client->shm_fd, (off_t)shm_size) != 0) {
+		obs_log(LOG_ERROR, "Failed to size decode host shared memory: %s", strerror(errno));
+		return false;
+	}
+
+	uint8_t *base = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, client->shm_fd, 0);
+	if (base == MAP_FAILED) {
+		obs_log(LOG_ERROR, "Failed to map decode host shared memory: %s", strerror(errno));
+		return false;
+	}
+
+	if (client->base) {
+		munmap(client->base, client->shm_size);
+	}
+	client->base = base;
+	client->shm = (struct decode_host_shm *)base;
+	client->slot_size = slot_size;
+	client->shm_size = shm_size;
+	client->shm->slot_size = slot_size;
+	return true;
+}
+
+// Reset shared state for a fresh helper: empty ring, helper owns slot 0, middle is 1, we show 2
+static void reset_shared_state(struct decode_host_client *client)
+{
+	atomic_store(&client->shm->input_write, 0);
+	atomic_store(&client->shm->input_read, 0);
+	atomic_store(&client->shm->output_middle, 1);
+	atomic_store(&client->shm->needed_slot_size, 0);
+	client->front = 2;
+	client->corrupt_frames = 0;
+}
+
+static bool spawn_host(struct decode_host_client *client)
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+		obs_log(LOG_ERROR, "Failed to create decode host socket: %s", strerror(errno));
+		return false;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, client->shm_fd, DECODE_HOST_SHM_FD);
+	posix_spawn_file_actions_adddup2(&actions, sv[1], DECODE_HOST_SOCKET_FD);
+
+	char *argv[] = {client->helper_path, client->conceal_errors ? "conceal" : "default", NULL};
+	int err = posix_spawn(&client->pid, client->helper_path, &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(sv[1]);
+
+	if (err != 0) {
+		obs_log(LOG_ERROR, "Failed to start %s: %s", client->helper_path, strerror(err));
+		close(sv[0]);
+		client->pid = 0;
+		return false;
+	}
+
+	client->sock = sv[0];
+	obs_log(LOG_INFO, "Decode host started (pid %d)", (int)client->pid);
+	return true;
+}
+
+// The shown slot is about to be reused or unmapped, so stop pointing the source at it
+static void release_shown_slot(struct decode_host_client *client)
+{
+	struct hang_source *context = client->context;
+	pthread_mutex_lock(&context->frame_mutex);
+	if (context->outputs[0].shared) {
+		context->outputs[0].data = NULL;
+		context->outputs[0].size = 0;
+		context->outputs[0].shared = false;
+	}
+	pthread_mutex_unlock(&context->frame_mutex);
+}
+
+// Called on the reader thread once the helper's socket reports EOF
+static bool restart_host(struct decode_host_client *client)
+{
+	pthread_mutex_lock(&client->lock);
+
+	int status = 0;
+	if (client->pid > 0) {
+		waitpid(client->pid, &status, 0);
+		client->pid = 0;
+	}
+	if (client->sock >= 0) {
+		close(client->sock);
+		client->sock = -1;
+	}
+
+	if (atomic_load(&client->stopping)) {
+		pthread_mutex_unlock(&client->lock);
+		return false;
+	}
+
+	// A larger picture than the slots hold is not a failure; grow them and carry on
+	size_t needed_slot_size = (size_t)atomic_load(&client->shm->needed_slot_size);
+	bool resize = WIFEXITED(status) && WEXITSTATUS(status) == DECODE_HOST_EXIT_RESIZE &&
+		      needed_slot_size > client->slot_size && needed_slot_size <= DECODE_HOST_MAX_SLOT_SIZE;
+
+	if (resize) {
+		obs_log(LOG_INFO, "Decode host needs %zu byte frame slots, restarting with more shared memory",
+			needed_slot_size);
+	} else if (WIFSIGNALED(status)) {
+		obs_log(LOG_WARNING, "Decode host crashed (signal %d), restarting", WTERMSIG(status));
+	} else {
+		obs_log(LOG_WARNING, "Decode host exited (status %d), restarting", WEXITSTATUS(status));
+	}
+
+	uint64_t now = os_gettime_ns();
+	if (now - client->restart_window_start_ns > RESTART_WINDOW_NS) {
+		client->restart_window_start_ns = now;
+		client->restarts = 0;
+	}
+	release_shown_slot(client);
+
+	// The decoder notices on its next packet and carries on in process
+	if (!resize && ++client->restarts > RESTART_LIMIT) {
+		obs_log(LOG_ERROR, "Decode host failed %d times within %d seconds, giving up on it", RESTART_LIMIT,
+			(int)(RESTART_WINDOW_NS / 1000000000ULL));
+		client->failed = true;
+		pthread_mutex_unlock(&client->lock);
+		return false;
+	}
+	if (resize && !map_shared(client, needed_slot_size)) {
+		client->failed = true;
+		pthread_mutex_unlock(&client->lock);
+		return false;
+	}
+
+	reset_shared_state(client);
+	bool started = spawn_host(client);
+	client->failed = !started;
+
+	// The new helper has no reference frames; rejoin at the next keyframe
+	atomic_store(&client->resync, true);
+
+	pthread_mutex_unlock(&client->lock);
+	return started;
+}
+
+// Show the helper's newest picture in place, without copying it out of shared memory
+static void deliver_frame(struct decode_host_client *client)
+{
+	struct hang_source *context = client->context;
+
+	pthread_mutex_lock(&context->frame_mutex);
+
+	if (!context->active || !(atomic_load(&client->shm->output_middle) & DECODE_HOST_SLOT_FRESH)) {
+		pthread_mutex_unlock(&context->frame_mutex);
+		return;
+	}
+
+	// The old front slot goes back to the helper; the renderer only reads under frame_mutex
+	uint32_t previous = atomic_exchange(&client->shm->output_middle, client->front);
+	client->front = previous & DECODE_HOST_SLOT_MASK;
+
+	const struct decode_host_frame *info = &client->shm->frames[client->front];
+
+	if (info->corrupt && client->conceal_errors) {
+		if (++client->corrupt_frames >= CONCEAL_MAX_CORRUPT_FRAMES) {
+			obs_log(LOG_WARNING, "Corruption persisted for %u frames, waiting for next keyframe",
+				client->corrupt_frames);
+			client->corrupt_frames = 0;
+			atomic_store(&client->resync, true);
+		}
+	} else if (!info->corrupt) {
+		client->corrupt_frames = 0;
+	}
+
+	// The helper only makes full-size frames; renders of smaller tiles fall back to it
+	struct frame_output *output = &context->outputs[0];
+	if (output->data && !output->shared) {
+		bfree(output->data);
+	}
+
+	output->data = client->base + decode_host_slot_offset(client->front, client->slot_size);
+	output->size = (size_t)info->width * info->height * 4;
+	output->width = info->width;
+	output->height = info->height;
+	output->shared = true;
+	output->frame_id = ++context->current_frame_id;
+	context->current_frame_timestamp_us = info->pts;
+	context->current_frame_width = info->width;
+	context->current_frame_height = info->height;
+
+	pthread_mutex_unlock(&context->frame_mutex);
+}
+
+static void *reader_thread_main(void *data)
+{
+	struct decode_host_client *client = data;
+	os_set_thread_name("hang-decode-host-reader");
+
+	while (!atomic_load(&client->stopping)) {
+		// Notifications coalesce; one swap picks up the newest frame
+		uint8_t buf[256];
+		ssize_t received = recv(client->sock, buf, sizeof(buf), 0);
+		if (received > 0) {
+			deliver_frame(client);
+			continue;
+		}
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (!restart_host(client)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+struct decode_host_client *decode_host_client_start(struct hang_source *context, bool conceal_errors)
+{
+	struct decode_host_client *client = bzalloc(sizeof(struct decode_host_client));
+	client->context = context;
+	client->conceal_errors = conceal_errors;
+	client->shm_fd = -1;
+	client->sock = -1;
+	pthread_mutex_init(&client->lock, NULL);
+
+	client->helper_path = find_helper_path();
+	if (!client->helper_path) {
+		obs_log(LOG_ERROR, "Could not locate %s", DECODE_HOST_EXECUTABLE);
+		goto fail;
+	}
+
+	// Anonymous shared memory: nothing to clean up by name if either side crashes
+	client->shm_fd = memfd_create("hang-decode-host", MFD_CLOEXEC);
+	if (client->shm_fd < 0) {
+		obs_log(LOG_ERROR, "Failed to create decode host shared memory: %s", strerror(errno));
+		goto fail;
+	}
+	if (!map_shared(client, DECODE_HOST_INITIAL_SLOT_SIZE)) {
+		goto fail;
+	}
+
+	reset_shared_state(client);
+	if (!spawn_host(client)) {
+		goto fail;
+	}
+
+	if (pthread_create(&client->reader_thread, NULL, reader_thread_main, client) != 0) {
+		obs_log(LOG_ERROR, "Failed to create decode host reader thread");
+		goto fail;
+	}
+	client->reader_running = true;
+
+	return client;
+
+fail:
+	decode_host_client_stop(client);
+	return NULL;
+}
+
+void decode_host_client_stop(struct decode_host_client *client)
+{
+	if (!client) {
+		return;
+	}
+
+	atomic_store(&client->stopping, true);
+
+	// Wake the reader thread and make sure a hung helper can't block shutdown
+	pthread_mutex_lock(&client->lock);
+	if (client->sock >= 0) {
+		shutdown(client->sock, SHUT_RDWR);
+	}
+	if (client->pid > 0) {
+		kill(client->pid, SIGKILL);
+	}
+	pthread_mutex_unlock(&client->lock);
+
+	if (client->reader_running) {
+		pthread_join(client->reader_thread, NULL);
+	}
+
+	if (client->pid > 0) {
+		waitpid(client->pid, NULL, 0);
+	}
+	if (client->sock >= 0) {
+		close(client->sock);
+	}
+	if (client->base) {
+		munmap(client->base, client->shm_size);
+	}
+	if (client->shm_fd >= 0) {
+		close(client->shm_fd);
+	}
+
+	pthread_mutex_destroy(&client->lock);
+	bfree(client->helper_path);
+	bfree(client);
+}
+
+static void ring_write(struct decode_host_shm *shm, uint64_t pos, const void *src, size_t size)
+{
+	size_t offset = pos % DECODE_HOST_INPUT_RING_SIZE;
+	size_t first = DECODE_HOST_INPUT_RING_SIZE - offset;
+	if (first > size) {
+		first = size;
+	}
+
+	memcpy(shm->input_ring + offset, src, first);
+	memcpy(shm->input_ring, (const uint8_t *)src + first, size - first);
+}
+
+bool decode_host_client_submit(struct decode_host_client *client, const uint8_t *data, size_t size, uint64_t pts,
+			       uint32_t suppress_frames, bool flush)
+{
+	pthread_mutex_lock(&client->lock);
+
+	if (client->failed || client->sock < 0) {
+		pthread_mutex_unlock(&client->lock);
+		return false;
+	}
+
+	struct decode_host_packet header = {
+		.size = (uint32_t)size,
+		.flags = flush ? DECODE_HOST_PACKET_FLUSH : 0,
+		.suppress_frames = suppress_frames,
+		.pts = pts,
+	};
+
+	struct decode_host_shm *shm = client->shm;
+	uint64_t write_pos = atomic_load(&shm->input_write);
+	uint64_t read_pos = atomic_load(&shm->input_read);
+	size_t needed = sizeof(header) + size;
+
+	// The helper is behind; dropping breaks references, so rejoin at the next keyframe
+	if (needed > DECODE_HOST_INPUT_RING_SIZE - (write_pos - read_pos)) {
+		pthread_mutex_unlock(&client->lock);
+		obs_log(LOG_WARNING, "Decode host input ring full, dropping frame");
+		atomic_store(&client->resync, true);
+		return false;
+	}
+
+	ring_write(shm, write_pos, &header, sizeof(header));
+	ring_write(shm, write_pos + sizeof(header), data, size);
+	atomic_store(&shm->input_write, write_pos + needed);
+
+	// A full socket buffer just means the helper already has a wake-up pending
+	uint8_t wake = 1;
+	send(client->sock, &wake, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+	pthread_mutex_unlock(&client->lock);
+	return true;
+}
+
+bool decode_host_client_failed(struct decode_host_client *client)
+{
+	pthread_mutex_lock(&client->lock);
+	bool failed = client->failed;
+	pthread_mutex_unlock(&client->lock);
+	return failed;
+}
+
+bool decode_host_client_take_resync(struct decode_host_client *client)
+{
+	return atomic_exchange(&client->resync, false);
+}
@@ -0,0 +1,35 @@
+/*
+Out-of-Process Decode Host Client for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct hang_source;
+struct decode_host_client;
+
+// Decode host functions
+struct decode_host_client *decode_host_client_start(struct hang_source *context, bool conceal_errors);
+void decode_host_client_stop(struct decode_host_client *client);
+bool decode_host_client_submit(struct decode_host_client *client, const uint8_t *data, size_t size, uint64_t pts,
+			       uint32_t suppress_frames, bool flush);
+bool decode_host_client_take_resync(struct decode_host_client *client);
+// The host could not be kept running; the caller should decode in process instead
+bool decode_host_client_failed(struct decode_host_client *client);
@@ -0,0 +1,97 @@
+/*
+Out-of-Process Decode Host Protocol for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+// Shared between the plugin and the hang-decode-host helper, which does not link libobs
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DECODE_HOST_EXECUTABLE "hang-decode-host"
+
+// File descriptors the helper inherits
+#define DECODE_HOST_SHM_FD 3
+#define DECODE_HOST_SOCKET_FD 4
+
+// Compressed input ring, written by the plugin and read by the helper
+#define DECODE_HOST_INPUT_RING_SIZE (4 * 1024 * 1024)
+
+// Decoded RGBA output, triple buffered so neither side ever waits or copies. Slots start
+// out sized for 1080p and only grow when the stream needs it, up to the maximum size.
+#define DECODE_HOST_MAX_WIDTH 4096
+#define DECODE_HOST_MAX_HEIGHT 2304
+#define DECODE_HOST_SLOT_COUNT 3
+#define DECODE_HOST_INITIAL_SLOT_SIZE ((size_t)1920 * 1088 * 4)
+#define DECODE_HOST_MAX_SLOT_SIZE ((size_t)DECODE_HOST_MAX_WIDTH * DECODE_HOST_MAX_HEIGHT * 4)
+
+// Helper exit status asking to be restarted with slots of at least needed_slot_size
+#define DECODE_HOST_EXIT_RESIZE 3
+
+// Triple buffer exchange: low bits hold a slot index, this bit marks an unread frame
+#define DECODE_HOST_SLOT_FRESH 0x4u
+#define DECODE_HOST_SLOT_MASK 0x3u
+
+// Packet flags
+#define DECODE_HOST_PACKET_FLUSH 0x1u // Drop decoder state before this packet
+
+struct decode_host_packet {
+	uint32_t size;            // Annex B payload bytes following this header
+	uint32_t flags;           // DECODE_HOST_PACKET_*
+	uint32_t suppress_frames; // Decoded pictures to discard (intra refresh still in progress)
+	uint32_t reserved;
+	uint64_t pts;
+};
+
+struct decode_host_frame {
+	uint32_t width;
+	uint32_t height;
+	uint64_t pts;
+	uint32_t corrupt; // Decoder reported errors or concealment in this picture
+	uint32_t reserved;
+};
+
+struct decode_host_shm {
+	// Input ring positions, as running byte totals
+	_Atomic uint64_t input_write;
+	_Atomic uint64_t input_read;
+
+	// Middle slot of the triple buffer; the helper owns one slot, the plugin another
+	_Atomic uint32_t output_middle;
+	uint32_t reserved;
+
+	uint64_t slot_size;                 // Set by the plugin before the helper starts
+	_Atomic uint64_t needed_slot_size; // Set by the helper before DECODE_HOST_EXIT_RESIZE
+
+	struct decode_host_frame frames[DECODE_HOST_SLOT_COUNT];
+
+	uint8_t input_ring[DECODE_HOST_INPUT_RING_SIZE];
+};
+
+// Slot pixels follow the header, page aligned
+static inline size_t decode_host_slot_offset(unsigned int slot, size_t slot_size)
+{
+	size_t header = (sizeof(struct decode_host_shm) + 4095) & ~(size_t)4095;
+	return header + (size_t)slot * slot_size;
+}
+
+static inline size_t decode_host_shm_size(size_t slot_size)
+{
+	return decode_host_slot_offset(DECODE_HOST_SLOT_COUNT, slot_size);
+}
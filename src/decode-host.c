@@ -0,0 +1,319 @@
+/*
+Out-of-Process Decode Host for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Standalone helper: decodes one source's compressed video into shared memory.
+// A crash here only takes down this process; the plugin restarts it.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/hwcontext.h>
+#include <libswscale/swscale.h>
+
+#include "decode-host-protocol.h"
+
+#define host_log(format, ...) fprintf(stderr, "[" DECODE_HOST_EXECUTABLE "] " format "\n", ##__VA_ARGS__)
+
+struct decode_host {
+	struct decode_host_shm *shm;
+	uint8_t *base;
+	size_t slot_size;
+	bool resize_needed; // A picture did not fit; exit so the plugin can grow the slots
+
+	AVBufferRef *hw_device_ctx;
+	AVCodecContext *codec_ctx;
+	struct SwsContext *sws_ctx;
+	AVFrame *frame;
+	AVFrame *sw_frame; // System memory copy of NVDEC output
+
+	uint8_t *packet_data;
+	size_t packet_cap;
+
+	unsigned int back; // Slot the helper writes next
+	uint32_t suppress_left;
+};
+
+static void ring_read(struct decode_host_shm *shm, uint64_t pos, void *dst, size_t size)
+{
+	size_t offset = pos % DECODE_HOST_INPUT_RING_SIZE;
+	size_t first = DECODE_HOST_INPUT_RING_SIZE - offset;
+	if (first > size) {
+		first = size;
+	}
+
+	memcpy(dst, shm->input_ring + offset, first);
+	memcpy((uint8_t *)dst + first, shm->input_ring, size - first);
+}
+
+static bool open_codec_with(struct decode_host *host, const AVCodec *codec, bool conceal_errors)
+{
+	host->codec_ctx = avcodec_alloc_context3(codec);
+	if (!host->codec_ctx) {
+		host_log("Failed to allocate codec context");
+		return false;
+	}
+
+	if (host->hw_device_ctx) {
+		host->codec_ctx->hw_device_ctx = av_buffer_ref(host->hw_device_ctx);
+		host->codec_ctx->extra_hw_frames = 1;
+	}
+
+	// Same concealment setup as the in-process decoder
+	if (conceal_errors) {
+		host->codec_ctx->error_concealment = FF_EC_GUESS_MVS | FF_EC_DEBLOCK | FF_EC_FAVOR_INTER;
+		host->codec_ctx->flags |= AV_CODEC_FLAG_OUTPUT_CORRUPT;
+		host->codec_ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
+	}
+
+	if (avcodec_open2(host->codec_ctx, codec, NULL) < 0) {
+		host_log("Failed to open codec %s", codec->name);
+		avcodec_free_context(&host->codec_ctx);
+		return false;
+	}
+
+	host_log("Decoding with %s", codec->name);
+	return true;
+}
+
+static bool open_codec(struct decode_host *host, bool conceal_errors)
+{
+	bool opened = false;
+
+#ifdef HAVE_NVDEC
+	// Prefer NVDEC, like the in-process decoder; pictures are copied back for conversion
+	const AVCodec *cuda_codec = avcodec_find_decoder_by_name("h264_cuvid");
+	if (cuda_codec && av_hwdevice_ctx_create(&host->hw_device_ctx, AV_HWDEVICE_TYPE_CUDA, NULL, NULL, 0) == 0) {
+		opened = open_codec_with(host, cuda_codec, conceal_errors);
+		if (!opened) {
+			av_buffer_unref(&host->hw_device_ctx);
+		}
+	}
+#endif
+
+	if (!opened) {
+		const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+		if (!codec) {
+			host_log("H.264 codec not found");
+			return false;
+		}
+		opened = open_codec_with(host, codec, conceal_errors);
+	}
+
+	host->frame = av_frame_alloc();
+	host->sw_frame = av_frame_alloc();
+	return opened && host->frame && host->sw_frame;
+}
+
+// Convert a decoded picture straight into the back slot and hand it to the plugin
+static void publish_frame(struct decode_host *host, const AVFrame *frame)
+{
+	if (frame->width > DECODE_HOST_MAX_WIDTH || frame->height > DECODE_HOST_MAX_HEIGHT) {
+		host_log("Frame %dx%d exceeds the largest shared slot size", frame->width, frame->height);
+		return;
+	}
+
+	size_t needed = (size_t)frame->width * frame->height * 4;
+	if (needed > host->slot_size) {
+		host_log("Frame %dx%d needs larger shared slots", frame->width, frame->height);
+		atomic_store(&host->shm->needed_slot_size, needed);
+		host->resize_needed = true;
+		return;
+	}
+
+	host->sws_ctx = sws_getCachedContext(host->sws_ctx, frame->width, frame->height,
+					     (enum AVPixelFormat)frame->format, frame->width, frame->height,
+					     AV_PIX_FMT_RGBA, SWS_BILINEAR | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT,
+					     NULL, NULL, NULL);
+	if (!host->sws_ctx) {
+		host_log("Failed to create SWS context");
+		return;
+	}
+
+	uint8_t *dst_data[4] = {host->base + decode_host_slot_offset(host->back, host->slot_size), NULL, NULL, NULL};
+	int dst_linesize[4] = {frame->width * 4, 0, 0, 0};
+	if (sws_scale(host->sws_ctx, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+		      dst_data, dst_linesize) < 0) {
+		host_log("sws_scale failed");
+		return;
+	}
+
+	struct decode_host_frame *info = &host->shm->frames[host->back];
+	info->width = (uint32_t)frame->width;
+	info->height = (uint32_t)frame->height;
+	info->pts = (uint64_t)frame->pts;
+	info->corrupt = frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT);
+
+	// Swap the finished slot into the middle and take back whatever was there
+	uint32_t previous = atomic_exchange(&host->shm->output_middle, host->back | DECODE_HOST_SLOT_FRESH);
+	host->back = previous & DECODE_HOST_SLOT_MASK;
+
+	uint8_t notify = 1;
+	send(DECODE_HOST_SOCKET_FD, &notify, 1, MSG_NOSIGNAL);
+}
+
+static void decode_packet(struct decode_host *host, const struct decode_host_packet *header)
+{
+	if (header->flags & DECODE_HOST_PACKET_FLUSH) {
+		avcodec_flush_buffers(host->codec_ctx);
+		host->suppress_left = 0;
+	}
+	if (header->suppress_frames > 0) {
+		host->suppress_left = header->suppress_frames;
+	}
+
+	AVPacket *packet = av_packet_alloc();
+	if (!packet) {
+		return;
+	}
+	packet->data = host->packet_data;
+	packet->size = (int)header->size;
+	packet->pts = (int64_t)header->pts;
+
+	int ret = avcodec_send_packet(host->codec_ctx, packet);
+	av_packet_free(&packet);
+	if (ret < 0) {
+		return;
+	}
+
+	while (!host->resize_needed && avcodec_receive_frame(host->codec_ctx, host->frame) == 0) {
+		if (host->suppress_left > 0) {
+			host->suppress_left--;
+		} else if (host->frame->format == AV_PIX_FMT_CUDA) {
+			// Transfer from GPU to CPU
+			host->sw_frame->format = AV_PIX_FMT_NV12;
+			if (av_hwframe_transfer_data(host->sw_frame, host->frame, 0) == 0) {
+				av_frame_copy_props(host->sw_frame, host->frame);
+				publish_frame(host, host->sw_frame);
+			} else {
+				host_log("Failed to transfer frame from GPU to CPU");
+			}
+			av_frame_unref(host->sw_frame);
+		} else {
+			publish_frame(host, host->frame);
+		}
+		av_frame_unref(host->frame);
+	}
+}
+
+// Decode every packet currently queued in the input ring
+static bool drain_input(struct decode_host *host)
+{
+	struct decode_host_shm *shm = host->shm;
+	uint64_t read_pos = atomic_load(&shm->input_read);
+	uint64_t write_pos = atomic_load(&shm->input_write);
+
+	while (!host->resize_needed && write_pos - read_pos >= sizeof(struct decode_host_packet)) {
+		struct decode_host_packet header;
+		ring_read(shm, read_pos, &header, sizeof(header));
+
+		if (header.size > DECODE_HOST_INPUT_RING_SIZE) {
+			host_log("Corrupt packet header (size %u)", header.size);
+			return false;
+		}
+
+		// Keep FFmpeg's required zeroed padding after the payload
+		size_t needed = (size_t)header.size + AV_INPUT_BUFFER_PADDING_SIZE;
+		if (needed > host->packet_cap) {
+			uint8_t *data = realloc(host->packet_data, needed);
+			if (!data) {
+				return false;
+			}
+			host->packet_data = data;
+			host->packet_cap = needed;
+		}
+		ring_read(shm, read_pos + sizeof(header), host->packet_data, header.size);
+		memset(host->packet_data + header.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+		read_pos += sizeof(header) + header.size;
+		atomic_store(&shm->input_read, read_pos);
+
+		decode_packet(host, &header);
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	bool conceal_errors = argc > 1 && strcmp(argv[1], "conceal") == 0;
+
+	struct decode_host host = {0};
+
+	// The plugin sizes the region for its current slot size
+	struct stat st;
+	if (fstat(DECODE_HOST_SHM_FD, &st) != 0 || (size_t)st.st_size < sizeof(struct decode_host_shm)) {
+		host_log("Shared memory missing or too small");
+		return 1;
+	}
+	size_t shm_size = (size_t)st.st_size;
+	host.base = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, DECODE_HOST_SHM_FD, 0);
+	if (host.base == MAP_FAILED) {
+		host_log("Failed to map shared memory: %s", strerror(errno));
+		return 1;
+	}
+	host.shm = (struct decode_host_shm *)host.base;
+	host.slot_size = (size_t)host.shm->slot_size;
+	host.back = 0;
+	if (host.slot_size == 0 || decode_host_shm_size(host.slot_size) > shm_size) {
+		host_log("Shared memory does not hold %d slots of %zu bytes", DECODE_HOST_SLOT_COUNT, host.slot_size);
+		return 1;
+	}
+
+	if (!open_codec(&host, conceal_errors)) {
+		return 1;
+	}
+
+	// One byte per submitted packet; EOF means the plugin stopped or went away
+	uint8_t wake[256];
+	while (true) {
+		ssize_t received = recv(DECODE_HOST_SOCKET_FD, wake, sizeof(wake), 0);
+		if (received == 0) {
+			break;
+		}
+		if (received < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (!drain_input(&host)) {
+			return 1;
+		}
+		if (host.resize_needed) {
+			break;
+		}
+	}
+
+	sws_freeContext(host.sws_ctx);
+	av_frame_free(&host.frame);
+	av_frame_free(&host.sw_frame);
+	avcodec_free_context(&host.codec_ctx);
+	av_buffer_unref(&host.hw_device_ctx);
+	free(host.packet_data);
+	munmap(host.base, shm_size);
+	return host.resize_needed ? DECODE_HOST_EXIT_RESIZE : 0;
+}
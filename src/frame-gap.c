@@ -0,0 +1,98 @@
+/*
+Frame Loss Detection for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <string.h>
+
+#include "frame-gap.h"
+
+// A timestamp step this much longer than the frame interval means frames went missing
+#define GAP_INTERVAL_FACTOR 1.5
+// After this many gaps in a row the publisher changed its frame rate instead
+#define GAP_RELEARN_COUNT 3
+
+void frame_gap_reset(struct frame_gap *gap, size_t reorder)
+{
+	memset(gap, 0, sizeof(*gap));
+	gap->reorder = reorder < FRAME_GAP_MAX_REORDER ? reorder : FRAME_GAP_MAX_REORDER;
+}
+
+// Compare one presentation-order step against the learned interval
+static uint32_t gap_check(struct frame_gap *gap, uint64_t timestamp_us)
+{
+	if (!gap->has_last) {
+		gap->has_last = true;
+		gap->last_us = timestamp_us;
+		return 0;
+	}
+
+	uint64_t delta_us = timestamp_us - gap->last_us;
+	gap->last_us = timestamp_us;
+
+	if (gap->interval_us == 0) {
+		gap->interval_us = delta_us;
+		return 0;
+	}
+
+	if ((double)delta_us <= (double)gap->interval_us * GAP_INTERVAL_FACTOR) {
+		gap->consecutive_gaps = 0;
+		gap->interval_us = (gap->interval_us * 7 + delta_us) / 8;
+		return 0;
+	}
+
+	if (++gap->consecutive_gaps >= GAP_RELEARN_COUNT) {
+		// The publisher lowered its frame rate; adopt the new interval
+		obs_log(LOG_DEBUG, "Frame interval changed from %llu to %llu us", (unsigned long long)gap->interval_us,
+			(unsigned long long)delta_us);
+		gap->interval_us = delta_us;
+		gap->consecutive_gaps = 0;
+		return 0;
+	}
+
+	return (uint32_t)((delta_us + gap->interval_us / 2) / gap->interval_us - 1);
+}
+
+uint32_t frame_gap_push(struct frame_gap *gap, uint64_t timestamp_us)
+{
+	// Too late to place in order (or a repeat); it was not lost, but there is nothing to learn
+	if (gap->has_last && timestamp_us <= gap->last_us) {
+		return 0;
+	}
+
+	size_t slot = gap->pending_count;
+	while (slot > 0 && gap->pending_us[slot - 1] > timestamp_us) {
+		slot--;
+	}
+	if (slot > 0 && gap->pending_us[slot - 1] == timestamp_us) {
+		return 0;
+	}
+	memmove(&gap->pending_us[slot + 1], &gap->pending_us[slot], (gap->pending_count - slot) * sizeof(uint64_t));
+	gap->pending_us[slot] = timestamp_us;
+	gap->pending_count++;
+
+	if (gap->pending_count <= gap->reorder) {
+		return 0;
+	}
+
+	// The window is full, so nothing earlier than its oldest entry can still arrive
+	uint64_t next_us = gap->pending_us[0];
+	gap->pending_count--;
+	memmove(&gap->pending_us[0], &gap->pending_us[1], gap->pending_count * sizeof(uint64_t));
+	return gap_check(gap, next_us);
+}
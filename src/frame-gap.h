@@ -0,0 +1,47 @@
+/*
+Frame Loss Detection for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most frames a stream may hold back for reordering that the detector can follow
+#define FRAME_GAP_MAX_REORDER 8
+// Reordering allowed for video: covers B-frame pyramids of common live encoders
+#define FRAME_GAP_VIDEO_REORDER 4
+
+// Finds lost frames from holes in the presentation-order timestamp sequence. Frames arrive
+// in decode order, so timestamps are first sorted through a small reorder window; a B-frame
+// arriving after the P-frame it references is not a gap.
+struct frame_gap {
+	size_t reorder;
+	uint64_t pending_us[FRAME_GAP_MAX_REORDER + 1]; // Sorted, oldest first
+	size_t pending_count;
+
+	bool has_last;
+	uint64_t last_us;
+	uint64_t interval_us;
+	uint32_t consecutive_gaps;
+};
+
+// Forget all timing, e.g. after a track switch; reorder is clamped to FRAME_GAP_MAX_REORDER
+void frame_gap_reset(struct frame_gap *gap, size_t reorder);
+// Feed an arriving frame's timestamp; returns how many frames were found missing
+uint32_t frame_gap_push(struct frame_gap *gap, uint64_t timestamp_us);
@@ -0,0 +1,145 @@
+/*
+Multi-Resolution Frame Outputs for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/sse-intrin.h>
+
+#include "hang-source.h"
+#include "frame-outputs.h"
+
+// Smallest level whose size still covers a draw at this scale of the full frame
+uint32_t frame_output_level_for_scale(float scale)
+{
+	uint32_t level = 0;
+	while (level + 1 < FRAME_OUTPUT_LEVELS && scale <= 1.0f / (float)(2u << level)) {
+		level++;
+	}
+	return level;
+}
+
+// Each level halves the one above it, rounding down like the box reduction does
+void frame_output_level_size(uint32_t width, uint32_t height, uint32_t level, uint32_t *level_width,
+			     uint32_t *level_height)
+{
+	*level_width = width >> level;
+	*level_height = height >> level;
+}
+
+// Sums of the left and right pixel of each horizontal pair among eight RGBA pixels, per
+// channel in 16 bits: lo holds the first two pairs, hi the last two
+static inline void sum_pairs(const uint8_t *src, __m128i *lo, __m128i *hi)
+{
+	__m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)src));
+	__m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 16)));
+
+	// Pixels are 32-bit lanes, so a float shuffle splits them into left and right of each pair
+	__m128i left = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i right = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	__m128i zero = _mm_setzero_si128();
+	*lo = _mm_add_epi16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(right, zero));
+	*hi = _mm_add_epi16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(right, zero));
+}
+
+// 2x2 box average of an RGBA image into one of half the size, (a + b + c + d + 2) / 4 per
+// channel. Four output pixels at a time with SSE2 (SIMDe on ARM), then any left over.
+void frame_output_reduce(const uint8_t *src, uint32_t src_width, uint32_t src_height, uint8_t *dst)
+{
+	uint32_t dst_width = src_width / 2;
+	uint32_t dst_height = src_height / 2;
+	size_t src_stride = (size_t)src_width * 4;
+	const __m128i round = _mm_set1_epi16(2);
+
+	for (uint32_t y = 0; y < dst_height; y++) {
+		const uint8_t *row0 = src + (size_t)y * 2 * src_stride;
+		const uint8_t *row1 = row0 + src_stride;
+		uint8_t *out = dst + (size_t)y * dst_width * 4;
+		uint32_t x = 0;
+
+		for (; x + 4 <= dst_width; x += 4) {
+			__m128i top_lo, top_hi, bottom_lo, bottom_hi;
+			sum_pairs(row0 + (size_t)x * 8, &top_lo, &top_hi);
+			sum_pairs(row1 + (size_t)x * 8, &bottom_lo, &bottom_hi);
+
+			__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top_lo, bottom_lo), round), 2);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top_hi, bottom_hi), round), 2);
+			_mm_storeu_si128((__m128i *)(out + (size_t)x * 4), _mm_packus_epi16(lo, hi));
+		}
+
+		for (; x < dst_width; x++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				size_t i = (size_t)x * 8 + c;
+				out[x * 4 + c] = (uint8_t)((row0[i] + row0[i + 4] + row1[i] + row1[i + 4] + 2) >> 2);
+			}
+		}
+	}
+}
+
+// Pick the output to draw for a requested level: the newest frame wins, and among
+// equally fresh outputs the requested size, then larger ones, then smaller ones.
+// Caller holds frame_mutex.
+struct frame_output *frame_outputs_select(struct hang_source *context, uint32_t level)
+{
+	struct frame_output *best = NULL;
+
+	for (uint32_t step = 0; step < FRAME_OUTPUT_LEVELS; step++) {
+		// Order: level, level - 1, ..., 0, level + 1, ...
+		uint32_t candidate = step <= level ? level - step : step;
+		struct frame_output *output = &context->outputs[candidate];
+
+		if (output->data && (!best || output->frame_id > best->frame_id)) {
+			best = output;
+		}
+	}
+
+	return best;
+}
+
+// Drop every output's pixels. Caller holds frame_mutex.
+void frame_outputs_clear(struct hang_source *context)
+{
+	for (uint32_t level = 0; level < FRAME_OUTPUT_LEVELS; level++) {
+		struct frame_output *output = &context->outputs[level];
+
+		if (output->data && !output->shared) {
+			bfree(output->data);
+		}
+		output->data = NULL;
+		output->size = 0;
+		output->width = 0;
+		output->height = 0;
+		output->shared = false;
+		output->frame_id = 0;
+	}
+}
+
+// Must be called from the graphics thread or inside obs_enter_graphics
+void frame_outputs_destroy_textures(struct hang_source *context)
+{
+	for (uint32_t level = 0; level < FRAME_OUTPUT_LEVELS; level++) {
+		struct frame_output *output = &context->outputs[level];
+
+		if (output->texture) {
+			gs_texture_destroy(output->texture);
+			output->texture = NULL;
+		}
+		output->texture_width = 0;
+		output->texture_height = 0;
+		output->texture_frame_id = 0;
+	}
+}
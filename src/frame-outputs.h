@@ -0,0 +1,50 @@
+/*
+Multi-Resolution Frame Outputs for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+struct hang_source;
+
+// Output sizes made from each decoded frame: full, half and quarter resolution
+#define FRAME_OUTPUT_LEVELS 3
+
+// One size of the current frame, plus the texture it is uploaded to
+struct frame_output {
+	uint8_t *data;
+	size_t size;
+	uint32_t width;
+	uint32_t height;
+	bool shared;       // Points into decode host shared memory, not owned
+	uint64_t frame_id; // Presented frame the data was made from
+
+	gs_texture_t *texture;
+	uint32_t texture_width;
+	uint32_t texture_height;
+	uint64_t texture_frame_id; // Frame currently uploaded to the texture
+};
+
+// Frame output functions
+uint32_t frame_output_level_for_scale(float scale);
+void frame_output_level_size(uint32_t width, uint32_t height, uint32_t level, uint32_t *level_width,
+			     uint32_t *level_height);
+void frame_output_reduce(const uint8_t *src, uint32_t src_width, uint32_t src_height, uint8_t *dst);
+struct frame_output *frame_outputs_select(struct hang_source *context, uint32_t level);
+void frame_outputs_clear(struct hang_source *context);
+void frame_outputs_destroy_textures(struct hang_source *context);
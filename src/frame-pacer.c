@@ -0,0 +1,306 @@
+/*
+Frame Pacing for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <plugin-support.h>
+#include <util/threading.h>
+#include <libswscale/swscale.h>
+#include <string.h>
+
+#include "hang-source.h"
+#include "frame-pacer.h"
+
+// Decoded frames waiting for their presentation time
+#define PACER_CAPACITY 8
+// Minimum playout delay that absorbs network and decode jitter
+#define PACER_MIN_BUFFER_NS 20000000LL
+// Clock correction applied per tick when the buffer runs dry or grows too deep
+#define PACER_SLEW_NS 200000LL
+// Timestamp jumps or lags beyond this restart the media clock
+#define PACER_DISCONTINUITY_NS 500000000LL
+
+// Maps the OBS video clock onto MoQ media time and picks one frame per tick.
+// Because the choice depends only on timestamps, a 25 fps feed on a 30 fps
+// canvas repeats every fifth frame on a fixed pattern instead of on arrival jitter.
+struct frame_pacer {
+	struct hang_source *context;
+
+	pthread_mutex_t mutex;
+	AVFrame *queue[PACER_CAPACITY];
+	size_t queue_len;
+
+	// OBS tick time minus media time, valid once the first frame is scheduled
+	bool clock_valid;
+	int64_t offset_ns;
+	int64_t frame_interval_ns;
+
+	// Used only from the tick: conversion state and recycled RGBA buffers per output size
+	struct SwsContext *sws_ctx;
+	uint8_t *back[FRAME_OUTPUT_LEVELS];
+	size_t back_size[FRAME_OUTPUT_LEVELS];
+};
+
+static inline int64_t frame_time_ns(const AVFrame *frame)
+{
+	return (int64_t)frame->pts * 1000;
+}
+
+static AVFrame *queue_pop(struct frame_pacer *pacer)
+{
+	AVFrame *frame = pacer->queue[0];
+	pacer->queue_len--;
+	memmove(pacer->queue, pacer->queue + 1, pacer->queue_len * sizeof(AVFrame *));
+	return frame;
+}
+
+static void queue_clear(struct frame_pacer *pacer)
+{
+	for (size_t i = 0; i < pacer->queue_len; i++) {
+		av_frame_free(&pacer->queue[i]);
+	}
+	pacer->queue_len = 0;
+	pacer->clock_valid = false;
+}
+
+struct frame_pacer *frame_pacer_create(struct hang_source *context)
+{
+	struct frame_pacer *pacer = bzalloc(sizeof(struct frame_pacer));
+	pacer->context = context;
+	pthread_mutex_init(&pacer->mutex, NULL);
+	return pacer;
+}
+
+void frame_pacer_destroy(struct frame_pacer *pacer)
+{
+	if (!pacer) {
+		return;
+	}
+
+	queue_clear(pacer);
+	if (pacer->sws_ctx) {
+		sws_freeContext(pacer->sws_ctx);
+	}
+	for (uint32_t level = 0; level < FRAME_OUTPUT_LEVELS; level++) {
+		bfree(pacer->back[level]);
+	}
+	pthread_mutex_destroy(&pacer->mutex);
+	bfree(pacer);
+}
+
+void frame_pacer_reset(struct frame_pacer *pacer)
+{
+	pthread_mutex_lock(&pacer->mutex);
+	queue_clear(pacer);
+	pacer->frame_interval_ns = 0;
+	pthread_mutex_unlock(&pacer->mutex);
+}
+
+void frame_pacer_push(struct frame_pacer *pacer, AVFrame *frame)
+{
+	pthread_mutex_lock(&pacer->mutex);
+
+	if (pacer->queue_len > 0) {
+		int64_t delta_ns = frame_time_ns(frame) - frame_time_ns(pacer->queue[pacer->queue_len - 1]);
+
+		// New broadcast or timestamp reset: start over rather than wait out the gap
+		if (delta_ns <= 0 || delta_ns > PACER_DISCONTINUITY_NS) {
+			queue_clear(pacer);
+		} else if (pacer->frame_interval_ns == 0) {
+			pacer->frame_interval_ns = delta_ns;
+		} else {
+			pacer->frame_interval_ns = (pacer->frame_interval_ns * 7 + delta_ns) / 8;
+		}
+	}
+
+	// Ticks stopped (source hidden) or we're far behind: keep only the newest frames
+	if (pacer->queue_len == PACER_CAPACITY) {
+		AVFrame *oldest = queue_pop(pacer);
+		av_frame_free(&oldest);
+	}
+
+	pacer->queue[pacer->queue_len++] = frame;
+	pthread_mutex_unlock(&pacer->mutex);
+}
+
+// Make the output sizes renders asked for from the selected frame, each into a buffer
+// recycled from the previous frame. swscale converts straight to the largest size
+// needed; smaller ones are box reduced from it, so tiles never pay for a full conversion.
+static void convert_and_store(struct frame_pacer *pacer, const AVFrame *frame)
+{
+	struct hang_source *context = pacer->context;
+	uint32_t width = (uint32_t)frame->width;
+	uint32_t height = (uint32_t)frame->height;
+
+	pthread_mutex_lock(&context->frame_mutex);
+	uint32_t wanted = context->wanted_levels;
+	context->wanted_levels = 0;
+	context->current_frame_width = width;
+	context->current_frame_height = height;
+	pthread_mutex_unlock(&context->frame_mutex);
+
+	// Not drawn anywhere since the last tick: skip conversion entirely
+	if (!wanted) {
+		return;
+	}
+
+	uint32_t first = 0;
+	while (!(wanted & (1u << first))) {
+		first++;
+	}
+	uint32_t last = first;
+	for (uint32_t level = first; level < FRAME_OUTPUT_LEVELS; level++) {
+		if (wanted & (1u << level)) {
+			last = level;
+		}
+	}
+
+	uint32_t level_width[FRAME_OUTPUT_LEVELS];
+	uint32_t level_height[FRAME_OUTPUT_LEVELS];
+	for (uint32_t level = first; level <= last; level++) {
+		frame_output_level_size(width, height, level, &level_width[level], &level_height[level]);
+		if (level_width[level] == 0 || level_height[level] == 0) {
+			// Too small to halve again
+			if (level == first) {
+				return;
+			}
+			last = level - 1;
+			break;
+		}
+
+		size_t rgba_size = (size_t)level_width[level] * level_height[level] * 4;
+		if (pacer->back_size[level] != rgba_size) {
+			bfree(pacer->back[level]);
+			pacer->back[level] = bmalloc(rgba_size);
+			pacer->back_size[level] = rgba_size;
+		}
+	}
+
+	pacer->sws_ctx = sws_getCachedContext(pacer->sws_ctx, frame->width, frame->height,
+					      (enum AVPixelFormat)frame->format, (int)level_width[first],
+					      (int)level_height[first], AV_PIX_FMT_RGBA,
+					      SWS_BILINEAR | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT, NULL, NULL, NULL);
+	if (!pacer->sws_ctx) {
+		obs_log(LOG_ERROR, "Failed to create SWS context");
+		return;
+	}
+
+	uint8_t *dst_data[4] = {pacer->back[first], NULL, NULL, NULL};
+	int dst_linesize[4] = {(int)level_width[first] * 4, 0, 0, 0};
+	if (sws_scale(pacer->sws_ctx, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+		      dst_data, dst_linesize) < 0) {
+		obs_log(LOG_ERROR, "sws_scale failed");
+		return;
+	}
+
+	// Levels in between are reduced too, as the step to the smaller ones
+	for (uint32_t level = first + 1; level <= last; level++) {
+		frame_output_reduce(pacer->back[level - 1], level_width[level - 1], level_height[level - 1],
+				    pacer->back[level]);
+	}
+
+	pthread_mutex_lock(&context->frame_mutex);
+
+	if (!context->active) {
+		pthread_mutex_unlock(&context->frame_mutex);
+		return;
+	}
+
+	// Swap buffers: the frames on screen become the next conversion targets
+	uint64_t frame_id = ++context->current_frame_id;
+	context->current_frame_timestamp_us = (uint64_t)frame->pts;
+	for (uint32_t level = first; level <= last; level++) {
+		struct frame_output *output = &context->outputs[level];
+		uint8_t *previous = NULL;
+		size_t previous_size = 0;
+		if (output->data && !output->shared) {
+			previous = output->data;
+			previous_size = output->size;
+		}
+
+		output->data = pacer->back[level];
+		output->size = pacer->back_size[level];
+		output->width = level_width[level];
+		output->height = level_height[level];
+		output->shared = false;
+		output->frame_id = frame_id;
+
+		pacer->back[level] = previous;
+		pacer->back_size[level] = previous_size;
+	}
+
+	pthread_mutex_unlock(&context->frame_mutex);
+}
+
+void frame_pacer_tick(struct frame_pacer *pacer, uint64_t tick_ns)
+{
+	AVFrame *selected = NULL;
+
+	pthread_mutex_lock(&pacer->mutex);
+
+	if (pacer->queue_len == 0) {
+		// Buffer ran dry: play out slightly later so the next frame has time to arrive
+		if (pacer->clock_valid) {
+			pacer->offset_ns += PACER_SLEW_NS;
+		}
+		pthread_mutex_unlock(&pacer->mutex);
+		return;
+	}
+
+	int64_t buffer_ns = pacer->frame_interval_ns > PACER_MIN_BUFFER_NS ? pacer->frame_interval_ns
+									     : PACER_MIN_BUFFER_NS;
+
+	if (!pacer->clock_valid) {
+		pacer->offset_ns = (int64_t)tick_ns - frame_time_ns(pacer->queue[0]) + buffer_ns;
+		pacer->clock_valid = true;
+	}
+
+	int64_t media_ns = (int64_t)tick_ns - pacer->offset_ns;
+
+	// After a stall everything is long overdue; re-anchor on the newest frame
+	if (media_ns - frame_time_ns(pacer->queue[pacer->queue_len - 1]) > PACER_DISCONTINUITY_NS) {
+		while (pacer->queue_len > 1) {
+			AVFrame *stale = queue_pop(pacer);
+			av_frame_free(&stale);
+		}
+		pacer->offset_ns = (int64_t)tick_ns - frame_time_ns(pacer->queue[0]);
+		media_ns = frame_time_ns(pacer->queue[0]);
+	}
+
+	// Show the newest frame that is due; older due frames are dropped unconverted
+	while (pacer->queue_len > 0 && frame_time_ns(pacer->queue[0]) <= media_ns) {
+		if (selected) {
+			av_frame_free(&selected);
+		}
+		selected = queue_pop(pacer);
+	}
+
+	// Too much buffered means latency is creeping up: catch up slowly to keep the cadence smooth
+	if (pacer->queue_len > 0) {
+		int64_t ahead_ns = frame_time_ns(pacer->queue[pacer->queue_len - 1]) - media_ns;
+		if (ahead_ns > buffer_ns + 2 * pacer->frame_interval_ns) {
+			pacer->offset_ns -= PACER_SLEW_NS;
+		}
+	}
+
+	pthread_mutex_unlock(&pacer->mutex);
+
+	if (selected) {
+		convert_and_store(pacer, selected);
+		av_frame_free(&selected);
+	}
+}
@@ -0,0 +1,32 @@
+/*
+Frame Pacing for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+struct hang_source;
+struct frame_pacer;
+
+// Frame pacer functions
+struct frame_pacer *frame_pacer_create(struct hang_source *context);
+void frame_pacer_destroy(struct frame_pacer *pacer);
+void frame_pacer_reset(struct frame_pacer *pacer);
+void frame_pacer_push(struct frame_pacer *pacer, AVFrame *frame);
+void frame_pacer_tick(struct frame_pacer *pacer, uint64_t tick_ns);
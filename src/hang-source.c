@@ -23,6 +23,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <media-io/video-io.h>
 #include <media-io/audio-io.h>
 #include <string.h>
+#include <math.h>
 
 // Include the moq library header
 #include <moq.h>
@@ -31,6 +32,8 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include "hang-source.h"
 #include "nvdec-decoder.h"
 #include "audio-decoder.h"
+#include "frame-pacer.h"
+#include "bandwidth-allocator.h"
 
 static const char *hang_source_get_name(void *type_data);
 static void *hang_source_create(obs_data_t *settings, obs_source_t *source);
@@ -38,6 +41,11 @@ static void hang_source_destroy(void *data);
 static void hang_source_update(void *data, obs_data_t *settings);
 static void hang_source_activate(void *data);
 static void hang_source_deactivate(void *data);
+static void hang_source_video_tick(void *data, float seconds);
+static void on_source_mute(void *data, calldata_t *cd);
+static void on_source_monitoring(void *data, calldata_t *cd);
+static void on_source_program(void *data, calldata_t *cd);
+static void on_source_off_program(void *data, calldata_t *cd);
 static void hang_source_video_render(void *data, gs_effect_t *effect);
 static uint32_t hang_source_get_width(void *data);
 static uint32_t hang_source_get_height(void *data);
@@ -48,9 +56,20 @@ static void hang_source_get_defaults(obs_data_t *settings);
 
 // MoQ callback functions (new API)
 static void on_session_status(void *user_data, int32_t code);
+#ifdef HAVE_MOQ_ORIGIN_PUBLISH
+static void on_relay_session_status(void *user_data, int32_t code);
+#endif
+static void on_announced(void *user_data, int32_t announced_id);
 static void on_catalog(void *user_data, int32_t catalog_id);
 static void on_video_frame(void *user_data, int32_t frame_id);
 static void on_audio_frame(void *user_data, int32_t frame_id);
+static size_t read_video_renditions(int32_t catalog_id, struct video_rendition *renditions);
+static void configure_audio_decoder(struct hang_source *context, int32_t catalog_id);
+static void subscribe_video_track(struct hang_source *context);
+static bool subscribe_broadcast(struct hang_source *context);
+static void unsubscribe_broadcast(struct hang_source *context);
+static void relay_start(struct hang_source *context);
+static void relay_stop(struct hang_source *context);
 
 
 struct obs_source_info hang_source_info = {
@@ -63,6 +82,7 @@ struct obs_source_info hang_source_info = {
 	.update = hang_source_update,
 	.activate = hang_source_activate,
 	.deactivate = hang_source_deactivate,
+	.video_tick = hang_source_video_tick,
 	.video_render = hang_source_video_render,
 	.get_width = hang_source_get_width,
 	.get_height = hang_source_get_height,
@@ -88,12 +108,12 @@ static void *hang_source_create(obs_data_t *settings, obs_source_t *source)
 	pthread_mutex_init(&context->audio_mutex, NULL);
 	pthread_cond_init(&context->audio_cond, NULL);
 	pthread_mutex_init(&context->decoder_mutex, NULL);
+	pthread_mutex_init_recursive(&context->session_mutex);
 
 	// Initialize frame storage
-	context->current_frame_data = NULL;
-	context->current_frame_size = 0;
 	context->current_frame_width = 0;
 	context->current_frame_height = 0;
+	context->pacer = frame_pacer_create(context);
 
 	// Initialize queues
 	context->frame_queue_cap = 16;
@@ -101,7 +121,17 @@ static void *hang_source_create(obs_data_t *settings, obs_source_t *source)
 	context->audio_queue_cap = 16;
 	context->audio_queue = bzalloc(sizeof(struct obs_source_audio *) * context->audio_queue_cap);
 
+	// Follow mute, monitoring and program state to skip audio decode nobody hears.
+	// OBS emits these as the source's saved state loads, so no initial query is needed.
+	context->audio_skip = true;
+	signal_handler_t *handler = obs_source_get_signal_handler(source);
+	signal_handler_connect(handler, "mute", on_source_mute, context);
+	signal_handler_connect(handler, "audio_monitoring", on_source_monitoring, context);
+	signal_handler_connect(handler, "activate", on_source_program, context);
+	signal_handler_connect(handler, "deactivate", on_source_off_program, context);
+
 	hang_source_update(context, settings);
+	bandwidth_allocator_add_source(context);
 	return context;
 }
 
@@ -109,6 +139,14 @@ static void hang_source_destroy(void *data)
 {
 	struct hang_source *context = data;
 
+	bandwidth_allocator_remove_source(context);
+
+	signal_handler_t *handler = obs_source_get_signal_handler(context->source);
+	signal_handler_disconnect(handler, "mute", on_source_mute, context);
+	signal_handler_disconnect(handler, "audio_monitoring", on_source_monitoring, context);
+	signal_handler_disconnect(handler, "activate", on_source_program, context);
+	signal_handler_disconnect(handler, "deactivate", on_source_off_program, context);
+
 	// Stop the source first (this will close all MoQ resources and destroy decoders)
 	hang_source_deactivate(context);
 
@@ -129,6 +167,10 @@ static void hang_source_destroy(void *data)
 		moq_consume_close(context->broadcast_id);
 		context->broadcast_id = 0;
 	}
+	if (context->announced_id > 0) {
+		moq_origin_announced_close(context->announced_id);
+		context->announced_id = 0;
+	}
 	if (context->session_id > 0) {
 		moq_session_close(context->session_id);
 		context->session_id = 0;
@@ -137,6 +179,7 @@ static void hang_source_destroy(void *data)
 		moq_origin_close(context->origin_id);
 		context->origin_id = 0;
 	}
+	relay_stop(context);
 
 	// Clean up decoders (should already be destroyed by deactivate, but check to be safe)
 	pthread_mutex_lock(&context->decoder_mutex);
@@ -145,19 +188,18 @@ static void hang_source_destroy(void *data)
 	pthread_mutex_unlock(&context->decoder_mutex);
 
 	// Clean up video resources
-	if (context->texture) {
-		gs_texture_destroy(context->texture);
-		context->texture = NULL;
-	}
+	obs_enter_graphics();
+	frame_outputs_destroy_textures(context);
+	obs_leave_graphics();
 
 	// Clean up frame data (should already be cleaned by deactivate, but check to be safe)
 	pthread_mutex_lock(&context->frame_mutex);
-	if (context->current_frame_data) {
-		bfree(context->current_frame_data);
-		context->current_frame_data = NULL;
-	}
+	frame_outputs_clear(context);
 	pthread_mutex_unlock(&context->frame_mutex);
 
+	frame_pacer_destroy(context->pacer);
+	context->pacer = NULL;
+
 	// Clean up queues (should already be cleaned by deactivate, but check to be safe)
 	pthread_mutex_lock(&context->frame_mutex);
 	for (size_t i = 0; i < context->frame_queue_len; i++) {
@@ -187,10 +229,12 @@ static void hang_source_destroy(void *data)
 	pthread_mutex_destroy(&context->audio_mutex);
 	pthread_cond_destroy(&context->audio_cond);
 	pthread_mutex_destroy(&context->decoder_mutex);
+	pthread_mutex_destroy(&context->session_mutex);
 
 	// Clean up strings
 	bfree(context->url);
 	bfree(context->broadcast_path);
+	bfree(context->relay_url);
 
 	bfree(context);
 }
@@ -201,12 +245,51 @@ static void hang_source_update(void *data, obs_data_t *settings)
 
 	const char *url = obs_data_get_string(settings, "url");
 	const char *broadcast_path = obs_data_get_string(settings, "broadcast");
+	const char *relay_url = obs_data_get_string(settings, "relay_url");
+	bool audio_first = obs_data_get_bool(settings, "audio_first");
+	bool conceal_errors = obs_data_get_bool(settings, "conceal_errors");
+	bool resync_on_loss = obs_data_get_bool(settings, "resync_on_loss");
+	bool decode_out_of_process = obs_data_get_bool(settings, "decode_out_of_process");
+
+	pthread_mutex_lock(&context->session_mutex);
+
+	// The congestion policy can be toggled without reconnecting
+	if (audio_first != context->audio_first) {
+		pthread_mutex_lock(&context->decoder_mutex);
+		bool restore_video = context->congestion.state == CONGESTION_STATE_AUDIO_ONLY;
+		context->audio_first = audio_first;
+		congestion_policy_reset(&context->congestion, audio_first);
+		pthread_mutex_unlock(&context->decoder_mutex);
+
+		if (restore_video && context->active && context->broadcast_id > 0 && context->video_track_id <= 0) {
+			subscribe_video_track(context);
+		}
+	}
+
+	// Loss handling is checked per frame, so it also applies without reconnecting
+	pthread_mutex_lock(&context->decoder_mutex);
+	context->resync_on_loss = resync_on_loss;
+	pthread_mutex_unlock(&context->decoder_mutex);
 
 	// Check if settings changed
 	bool url_changed = !context->url || strcmp(context->url, url) != 0;
 	bool broadcast_changed = !context->broadcast_path || strcmp(context->broadcast_path, broadcast_path) != 0;
+	bool conceal_changed = conceal_errors != context->conceal_errors ||
+			       decode_out_of_process != context->decode_out_of_process;
+	bool relay_changed = !context->relay_url || strcmp(context->relay_url, relay_url) != 0;
+
+	// The relay only re-publishes; switching it leaves local playback alone
+	if (relay_changed) {
+		relay_stop(context);
+		bfree(context->relay_url);
+		context->relay_url = bstrdup(relay_url);
+		if (context->active && context->broadcast_id > 0) {
+			relay_start(context);
+		}
+	}
 
-	if (!url_changed && !broadcast_changed) {
+	if (!url_changed && !broadcast_changed && !conceal_changed) {
+		pthread_mutex_unlock(&context->session_mutex);
 		return;
 	}
 
@@ -218,19 +301,20 @@ static void hang_source_update(void *data, obs_data_t *settings)
 	bfree(context->broadcast_path);
 	context->url = bstrdup(url);
 	context->broadcast_path = bstrdup(broadcast_path);
+	// Concealment and decode placement are set when the decoder opens, so they need a restart
+	context->conceal_errors = conceal_errors;
+	context->decode_out_of_process = decode_out_of_process;
 
 	// Reconnect if we have valid settings
-	if (url_changed || broadcast_changed) {
-		if (context->url && context->broadcast_path && strlen(context->url) > 0 && strlen(context->broadcast_path) > 0) {
-			hang_source_activate(context);
-		}
+	if (context->url && context->broadcast_path && strlen(context->url) > 0 && strlen(context->broadcast_path) > 0) {
+		hang_source_activate(context);
 	}
+
+	pthread_mutex_unlock(&context->session_mutex);
 }
 
-static void hang_source_activate(void *data)
+static void activate_locked(struct hang_source *context)
 {
-	struct hang_source *context = data;
-
 	if (context->active || !context->url || !context->broadcast_path ||
 	    strlen(context->url) == 0 || strlen(context->broadcast_path) == 0) {
 		return;
@@ -250,6 +334,8 @@ static void hang_source_activate(void *data)
 
 	obs_log(LOG_INFO, "Activating hang source with URL: %s, broadcast: %s", context->url, context->broadcast_path);
 
+	congestion_policy_reset(&context->congestion, context->audio_first);
+
 	// Initialize decoders first (local operation, doesn't need network)
 	if (!nvdec_decoder_init(context)) {
 		obs_log(LOG_ERROR, "Failed to initialize video decoder");
@@ -303,10 +389,17 @@ cleanup:
 	audio_decoder_destroy(context);
 }
 
-static void hang_source_deactivate(void *data)
+static void hang_source_activate(void *data)
 {
 	struct hang_source *context = data;
 
+	pthread_mutex_lock(&context->session_mutex);
+	activate_locked(context);
+	pthread_mutex_unlock(&context->session_mutex);
+}
+
+static void deactivate_locked(struct hang_source *context)
+{
 	if (!context->active) {
 		return;
 	}
@@ -317,7 +410,8 @@ static void hang_source_deactivate(void *data)
 	context->active = false;
 
 	// Close MoQ resources in reverse order to stop new callbacks
-	// 1. Close track subscriptions first
+	// 1. Stop re-publishing and close track subscriptions first
+	relay_stop(context);
 	if (context->audio_track_id > 0) {
 		moq_consume_audio_track_close(context->audio_track_id);
 		context->audio_track_id = 0;
@@ -339,13 +433,19 @@ static void hang_source_deactivate(void *data)
 		context->broadcast_id = 0;
 	}
 
-	// 4. Close session
+	// 4. Stop watching announcements
+	if (context->announced_id > 0) {
+		moq_origin_announced_close(context->announced_id);
+		context->announced_id = 0;
+	}
+
+	// 5. Close session
 	if (context->session_id > 0) {
 		moq_session_close(context->session_id);
 		context->session_id = 0;
 	}
 
-	// 5. Close origin
+	// 6. Close origin
 	if (context->origin_id > 0) {
 		moq_origin_close(context->origin_id);
 		context->origin_id = 0;
@@ -354,13 +454,10 @@ static void hang_source_deactivate(void *data)
 	// Clear current frame and queues BEFORE destroying decoders
 	// This prevents callbacks from accessing freed decoder resources
 	pthread_mutex_lock(&context->frame_mutex);
-	if (context->current_frame_data) {
-		bfree(context->current_frame_data);
-		context->current_frame_data = NULL;
-		context->current_frame_size = 0;
-		context->current_frame_width = 0;
-		context->current_frame_height = 0;
-	}
+	frame_outputs_clear(context);
+	context->current_frame_width = 0;
+	context->current_frame_height = 0;
+	context->current_frame_timestamp_us = 0;
 
 	// Clear queues
 	for (size_t i = 0; i < context->frame_queue_len; i++) {
@@ -369,6 +466,9 @@ static void hang_source_deactivate(void *data)
 	context->frame_queue_len = 0;
 	pthread_mutex_unlock(&context->frame_mutex);
 
+	// Drop decoded frames still waiting for presentation
+	frame_pacer_reset(context->pacer);
+
 	pthread_mutex_lock(&context->audio_mutex);
 	for (size_t i = 0; i < context->audio_queue_len; i++) {
 		// Free the audio data channels
@@ -392,6 +492,15 @@ static void hang_source_deactivate(void *data)
 	obs_log(LOG_INFO, "Hang source deactivated");
 }
 
+static void hang_source_deactivate(void *data)
+{
+	struct hang_source *context = data;
+
+	pthread_mutex_lock(&context->session_mutex);
+	deactivate_locked(context);
+	pthread_mutex_unlock(&context->session_mutex);
+}
+
 static obs_properties_t *hang_source_get_properties(void *data)
 {
 	UNUSED_PARAMETER(data);
@@ -400,6 +509,15 @@ static obs_properties_t *hang_source_get_properties(void *data)
 
 	obs_properties_add_text(props, "url", obs_module_text("URL"), OBS_TEXT_DEFAULT);
 	obs_properties_add_text(props, "broadcast", obs_module_text("Broadcast"), OBS_TEXT_DEFAULT);
+#ifdef HAVE_MOQ_ORIGIN_PUBLISH
+	obs_properties_add_text(props, "relay_url", obs_module_text("RelayURL"), OBS_TEXT_DEFAULT);
+#endif
+	obs_properties_add_bool(props, "audio_first", obs_module_text("AudioFirst"));
+	obs_properties_add_bool(props, "resync_on_loss", obs_module_text("ResyncOnLoss"));
+	obs_properties_add_bool(props, "conceal_errors", obs_module_text("ConcealErrors"));
+#ifdef HAVE_DECODE_HOSTS
+	obs_properties_add_bool(props, "decode_out_of_process", obs_module_text("DecodeOutOfProcess"));
+#endif
 
 	return props;
 }
@@ -408,6 +526,70 @@ static void hang_source_get_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, "url", "");
 	obs_data_set_default_string(settings, "broadcast", "");
+	obs_data_set_default_string(settings, "relay_url", "");
+	obs_data_set_default_bool(settings, "audio_first", true);
+	obs_data_set_default_bool(settings, "resync_on_loss", false);
+	obs_data_set_default_bool(settings, "conceal_errors", false);
+	obs_data_set_default_bool(settings, "decode_out_of_process", false);
+}
+
+// Audio is heard if it reaches the program mix unmuted, or through monitoring
+static void update_audio_skip(struct hang_source *context)
+{
+	bool heard = (context->audio_on_program && !context->audio_muted) || context->audio_monitored;
+	os_atomic_set_bool(&context->audio_skip, !heard);
+}
+
+static void on_source_mute(void *data, calldata_t *cd)
+{
+	struct hang_source *context = data;
+	context->audio_muted = calldata_bool(cd, "muted");
+	update_audio_skip(context);
+}
+
+static void on_source_monitoring(void *data, calldata_t *cd)
+{
+	struct hang_source *context = data;
+	context->audio_monitored = calldata_int(cd, "type") != OBS_MONITORING_TYPE_NONE;
+	update_audio_skip(context);
+}
+
+static void on_source_program(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct hang_source *context = data;
+	context->audio_on_program = true;
+	update_audio_skip(context);
+}
+
+static void on_source_off_program(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct hang_source *context = data;
+	context->audio_on_program = false;
+	update_audio_skip(context);
+}
+
+static void hang_source_video_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	struct hang_source *context = data;
+
+	if (!context->active) {
+		return;
+	}
+
+	// Before the first video frame is rendered, or with no video thread at all (the soak
+	// harness), libobs has no frame time yet; it uses the same clock as os_gettime_ns
+	uint64_t tick_ns = obs_get_video_frame_time();
+	if (tick_ns == 0) {
+		tick_ns = os_gettime_ns();
+	}
+
+	// Select (and convert) the frame for this tick by its MoQ timestamp
+	frame_pacer_tick(context->pacer, tick_ns);
+
+	audio_decoder_output(context);
 }
 
 static void hang_source_video_render(void *data, gs_effect_t *effect)
@@ -418,41 +600,58 @@ static void hang_source_video_render(void *data, gs_effect_t *effect)
 		return;
 	}
 
+	// On-screen scale of this draw: the current transform covers scene item sizing
+	// and multiview or projector tiles, which render the same source smaller
+	struct matrix4 transform;
+	gs_matrix_get(&transform);
+	float scale_x = hypotf(transform.x.x, transform.x.y);
+	float scale_y = hypotf(transform.y.x, transform.y.y);
+	uint32_t level = frame_output_level_for_scale(scale_x > scale_y ? scale_x : scale_y);
+
 	// Get the current frame data
 	pthread_mutex_lock(&context->frame_mutex);
-	if (context->current_frame_data && context->current_frame_width > 0 && context->current_frame_height > 0) {
-		uint32_t width = context->current_frame_width;
-		uint32_t height = context->current_frame_height;
+
+	// The next tick makes every size that was drawn this frame
+	context->wanted_levels |= 1u << level;
+
+	struct frame_output *output = frame_outputs_select(context, level);
+	if (output && context->current_frame_width > 0 && context->current_frame_height > 0) {
+		uint32_t width = output->width;
+		uint32_t height = output->height;
 
 		// Create or update texture if needed
-		if (!context->texture || context->width != width || context->height != height) {
-			if (context->texture) {
-				gs_texture_destroy(context->texture);
+		if (!output->texture || output->texture_width != width || output->texture_height != height) {
+			if (output->texture) {
+				gs_texture_destroy(output->texture);
 			}
-			context->texture = gs_texture_create(width, height, GS_RGBA, 1, NULL, GS_DYNAMIC);
-			context->width = width;
-			context->height = height;
+			output->texture = gs_texture_create(width, height, GS_RGBA, 1, NULL, GS_DYNAMIC);
+			output->texture_width = width;
+			output->texture_height = height;
+			output->texture_frame_id = 0;
 		}
 
-		if (context->texture) {
+		if (output->texture) {
 			// Validate RGBA data (check if it's not all black)
 			bool has_data = false;
-			for (size_t i = 0; i < context->current_frame_size && i < 10000; i += 4) {
-				if (context->current_frame_data[i] > 0 || context->current_frame_data[i+1] > 0 ||
-				    context->current_frame_data[i+2] > 0) {
+			for (size_t i = 0; i < output->size && i < 10000; i += 4) {
+				if (output->data[i] > 0 || output->data[i+1] > 0 || output->data[i+2] > 0) {
 					has_data = true;
 					break;
 				}
 			}
 
-			// Upload frame data to texture
-			gs_texture_set_image(context->texture, context->current_frame_data, width * 4, false);
+			// Upload only when the pacer selected a new frame; repeats reuse the texture
+			if (output->texture_frame_id != output->frame_id) {
+				gs_texture_set_image(output->texture, output->data, width * 4, false);
+				output->texture_frame_id = output->frame_id;
+			}
 
-			// Render the texture
+			// Render the texture, stretched back to the source size
 			gs_eparam_t *param = gs_effect_get_param_by_name(effect, "image");
 			if (param) {
-				gs_effect_set_texture(param, context->texture);
-				gs_draw_sprite(context->texture, 0, width, height);
+				gs_effect_set_texture(param, output->texture);
+				gs_draw_sprite(output->texture, 0, context->current_frame_width,
+					       context->current_frame_height);
 			} else {
 				obs_log(LOG_ERROR, "Effect parameter 'image' not found");
 			}
@@ -484,42 +683,232 @@ static void on_session_status(void *user_data, int32_t code)
 		return;
 	}
 
-	if (code == 0) {
-		obs_log(LOG_INFO, "MoQ session connected, subscribing to broadcast...");
+	pthread_mutex_lock(&context->session_mutex);
 
-		// Now that session is connected, subscribe to the broadcast
-		context->broadcast_id = moq_origin_consume(context->origin_id, context->broadcast_path, strlen(context->broadcast_path));
-		if (context->broadcast_id <= 0) {
-			obs_log(LOG_ERROR, "Failed to consume broadcast: %s (error %d)", 
-				context->broadcast_path, context->broadcast_id);
-			context->active = false;
-			return;
-		}
-		obs_log(LOG_INFO, "Subscribed to broadcast: %s (id %d)", 
-			context->broadcast_path, context->broadcast_id);
-
-		// Subscribe to catalog updates
-		context->catalog_consumer_id = moq_consume_catalog(
-			context->broadcast_id,
-			on_catalog,
-			context
-		);
-		if (context->catalog_consumer_id <= 0) {
-			obs_log(LOG_ERROR, "Failed to subscribe to catalog: %d", context->catalog_consumer_id);
-			moq_consume_close(context->broadcast_id);
-			context->broadcast_id = 0;
-			context->active = false;
-			return;
+	if (!context->active) {
+		// Status from a session this source already closed
+	} else if (code == 0) {
+		obs_log(LOG_INFO, "MoQ session connected, waiting for broadcast announcement...");
+
+		// Watch announcements so we subscribe the moment the publisher goes live,
+		// whether it is already live or starts later
+		context->announced_id = moq_origin_announced(context->origin_id, on_announced, context);
+		if (context->announced_id <= 0) {
+			obs_log(LOG_WARNING, "Failed to watch announcements (error %d), subscribing directly",
+				context->announced_id);
+			context->announced_id = 0;
+			subscribe_broadcast(context);
 		}
-		obs_log(LOG_INFO, "Subscribed to catalog (id %d)", context->catalog_consumer_id);
 
 	} else if (code < 0) {
 		obs_log(LOG_ERROR, "MoQ session error: %d", code);
 		// Session failed - mark as inactive
 		context->active = false;
 	}
+
+	pthread_mutex_unlock(&context->session_mutex);
+}
+
+#ifdef HAVE_MOQ_ORIGIN_PUBLISH
+static void on_relay_session_status(void *user_data, int32_t code)
+{
+	struct hang_source *context = user_data;
+
+	if (!context) {
+		return;
+	}
+
+	pthread_mutex_lock(&context->session_mutex);
+
+	if (context->relay_session_id <= 0) {
+		// Status from a relay session that was already stopped
+	} else if (code == 0) {
+		obs_log(LOG_INFO, "Relay session connected: %s", context->relay_url);
+	} else if (code < 0) {
+		// Only the re-publish is lost; local playback is unaffected
+		obs_log(LOG_ERROR, "Relay session error: %d", code);
+	}
+
+	pthread_mutex_unlock(&context->session_mutex);
+}
+#endif
+
+static void on_announced(void *user_data, int32_t announced_id)
+{
+	struct hang_source *context = user_data;
+
+	if (!context || !context->active) {
+		return;
+	}
+
+	if (announced_id <= 0) {
+		obs_log(LOG_ERROR, "Announcement error: %d", announced_id);
+		return;
+	}
+
+	struct Announced info = {0};
+	int32_t result = moq_origin_announced_info(announced_id, &info);
+	if (result < 0) {
+		obs_log(LOG_ERROR, "Failed to get announcement info: %d", result);
+		return;
+	}
+
+	// The broadcast path is replaced by settings changes under the session lock
+	pthread_mutex_lock(&context->session_mutex);
+	if (!context->active || !context->broadcast_path) {
+		// Deactivated while this announcement was being read
+	} else if (info.path_len != strlen(context->broadcast_path) ||
+		   memcmp(info.path, context->broadcast_path, info.path_len) != 0) {
+		// Another broadcast on the same relay
+	} else if (info.active) {
+		if (context->broadcast_id <= 0) {
+			obs_log(LOG_INFO, "Broadcast announced: %s", context->broadcast_path);
+			subscribe_broadcast(context);
+		}
+	} else {
+		// Publisher went away; drop the stale subscription and wait for the next announcement
+		obs_log(LOG_INFO, "Broadcast unannounced: %s", context->broadcast_path);
+		unsubscribe_broadcast(context);
+	}
+	pthread_mutex_unlock(&context->session_mutex);
+}
+
+static bool subscribe_broadcast(struct hang_source *context)
+{
+	// Decoders were created on activation, so the first frame decodes immediately
+	pthread_mutex_lock(&context->decoder_mutex);
+	congestion_policy_reset(&context->congestion, context->audio_first);
+	nvdec_decoder_resync(context);
+	pthread_mutex_unlock(&context->decoder_mutex);
+
+	context->broadcast_id = moq_origin_consume(context->origin_id, context->broadcast_path, strlen(context->broadcast_path));
+	if (context->broadcast_id <= 0) {
+		obs_log(LOG_ERROR, "Failed to consume broadcast: %s (error %d)", 
+			context->broadcast_path, context->broadcast_id);
+		context->broadcast_id = 0;
+		context->active = false;
+		return false;
+	}
+	obs_log(LOG_INFO, "Subscribed to broadcast: %s (id %d)", 
+		context->broadcast_path, context->broadcast_id);
+
+	// Subscribe to catalog updates
+	context->catalog_consumer_id = moq_consume_catalog(
+		context->broadcast_id,
+		on_catalog,
+		context
+	);
+	if (context->catalog_consumer_id <= 0) {
+		obs_log(LOG_ERROR, "Failed to subscribe to catalog: %d", context->catalog_consumer_id);
+		moq_consume_close(context->broadcast_id);
+		context->broadcast_id = 0;
+		context->catalog_consumer_id = 0;
+		context->active = false;
+		return false;
+	}
+	obs_log(LOG_INFO, "Subscribed to catalog (id %d)", context->catalog_consumer_id);
+
+	relay_start(context);
+	return true;
+}
+
+static void unsubscribe_broadcast(struct hang_source *context)
+{
+	relay_stop(context);
+	if (context->audio_track_id > 0) {
+		moq_consume_audio_track_close(context->audio_track_id);
+		context->audio_track_id = 0;
+	}
+	if (context->video_track_id > 0) {
+		moq_consume_video_track_close(context->video_track_id);
+		context->video_track_id = 0;
+	}
+	if (context->catalog_consumer_id > 0) {
+		moq_consume_catalog_close(context->catalog_consumer_id);
+		context->catalog_consumer_id = 0;
+	}
+	if (context->broadcast_id > 0) {
+		moq_consume_close(context->broadcast_id);
+		context->broadcast_id = 0;
+	}
 }
 
+// Re-publish the subscribed broadcast as-is. The relay session publishes the origin the
+// upstream session consumes into, so catalog, groups and frames are forwarded by reference
+// with nothing decoded or copied here. A relay failure is not fatal; playback continues.
+// Caller holds session_mutex.
+#ifdef HAVE_MOQ_ORIGIN_PUBLISH
+// The relay session publishes a dedicated origin holding only this broadcast; the upstream
+// origin carries every broadcast the upstream relay announces. Caller holds session_mutex.
+static void relay_start(struct hang_source *context)
+{
+	if (context->relay_session_id > 0 || context->broadcast_id <= 0 || !context->relay_url ||
+	    strlen(context->relay_url) == 0) {
+		return;
+	}
+
+	context->relay_origin_id = moq_origin_create();
+	if (context->relay_origin_id <= 0) {
+		obs_log(LOG_WARNING, "Failed to create relay origin (error %d), re-publish disabled",
+			context->relay_origin_id);
+		context->relay_origin_id = 0;
+		return;
+	}
+
+	int32_t result = moq_origin_publish(context->relay_origin_id, context->broadcast_path,
+					    strlen(context->broadcast_path), context->broadcast_id);
+	if (result < 0) {
+		obs_log(LOG_WARNING, "Failed to publish broadcast to relay origin (error %d), re-publish disabled",
+			result);
+		relay_stop(context);
+		return;
+	}
+
+	context->relay_session_id = moq_session_connect(
+		context->relay_url,
+		strlen(context->relay_url),
+		context->relay_origin_id, // publish just this broadcast
+		0,                        // nothing to consume
+		on_relay_session_status,
+		context
+	);
+	if (context->relay_session_id <= 0) {
+		obs_log(LOG_WARNING, "Failed to create relay session (error %d), re-publish disabled",
+			context->relay_session_id);
+		context->relay_session_id = 0;
+		relay_stop(context);
+		return;
+	}
+	obs_log(LOG_INFO, "Re-publishing broadcast %s to %s", context->broadcast_path, context->relay_url);
+}
+
+// Closing the session unannounces everything it published. Caller holds session_mutex.
+static void relay_stop(struct hang_source *context)
+{
+	if (context->relay_session_id > 0) {
+		moq_session_close(context->relay_session_id);
+		context->relay_session_id = 0;
+		obs_log(LOG_INFO, "Stopped re-publishing to %s", context->relay_url);
+	}
+	if (context->relay_origin_id > 0) {
+		moq_origin_close(context->relay_origin_id);
+		context->relay_origin_id = 0;
+	}
+}
+#else
+// Without moq_origin_publish the only origin to publish is the upstream one, which would
+// forward every broadcast on the upstream relay, so re-publishing is not offered at all
+static void relay_start(struct hang_source *context)
+{
+	UNUSED_PARAMETER(context);
+}
+
+static void relay_stop(struct hang_source *context)
+{
+	UNUSED_PARAMETER(context);
+}
+#endif
+
 static void on_catalog(void *user_data, int32_t catalog_id)
 {
 	struct hang_source *context = user_data;
@@ -534,6 +923,24 @@ static void on_catalog(void *user_data, int32_t catalog_id)
 	}
 
 	obs_log(LOG_INFO, "Received catalog update: %d", catalog_id);
+	os_atomic_inc_long(&context->catalog_updates);
+
+	// Collect the video renditions so bandwidth ceilings can choose between them
+	struct video_rendition renditions[MAX_VIDEO_RENDITIONS];
+	size_t rendition_count = read_video_renditions(catalog_id, renditions);
+
+	pthread_mutex_lock(&context->session_mutex);
+	if (!context->active || context->catalog_consumer_id <= 0) {
+		// Unsubscribed while the catalog was being read
+		pthread_mutex_unlock(&context->session_mutex);
+		return;
+	}
+
+	pthread_mutex_lock(&context->decoder_mutex);
+	memcpy(context->renditions, renditions, sizeof(renditions));
+	context->rendition_count = rendition_count;
+	configure_audio_decoder(context, catalog_id);
+	pthread_mutex_unlock(&context->decoder_mutex);
 
 	// Close existing track subscriptions if any
 	if (context->video_track_id > 0) {
@@ -545,18 +952,13 @@ static void on_catalog(void *user_data, int32_t catalog_id)
 		context->audio_track_id = 0;
 	}
 
-	// Subscribe to first video track (index 0) with 100ms latency
-	context->video_track_id = moq_consume_video_track(
-		context->broadcast_id,
-		0,     // first track
-		100,   // 100ms latency
-		on_video_frame,
-		context
-	);
-	if (context->video_track_id <= 0) {
-		obs_log(LOG_WARNING, "Failed to subscribe to video track: %d", context->video_track_id);
-	} else {
-		obs_log(LOG_INFO, "Subscribed to video track: %d", context->video_track_id);
+	// Video stays unsubscribed while the congestion policy is protecting audio
+	pthread_mutex_lock(&context->decoder_mutex);
+	bool audio_only = context->congestion.state == CONGESTION_STATE_AUDIO_ONLY;
+	pthread_mutex_unlock(&context->decoder_mutex);
+
+	if (!audio_only) {
+		subscribe_video_track(context);
 	}
 
 	// Subscribe to first audio track (index 0) with 100ms latency
@@ -572,6 +974,127 @@ static void on_catalog(void *user_data, int32_t catalog_id)
 	} else {
 		obs_log(LOG_INFO, "Subscribed to audio track: %d", context->audio_track_id);
 	}
+
+	pthread_mutex_unlock(&context->session_mutex);
+}
+
+#ifdef HAVE_MOQ_VIDEO_CONFIG
+// Rough bitrate for renditions whose catalog entry has none: 0.1 bits per pixel at 30 fps
+#define RENDITION_ESTIMATE_BITS_PER_PIXEL_SECOND 3
+
+static size_t read_video_renditions(int32_t catalog_id, struct video_rendition *renditions)
+{
+	size_t count = 0;
+
+	for (uint32_t index = 0; count < MAX_VIDEO_RENDITIONS; index++) {
+		struct VideoConfig config = {0};
+		if (moq_consume_video_config(catalog_id, index, &config) < 0) {
+			break;
+		}
+
+		struct video_rendition rendition = {
+			.index = index,
+			.width = config.coded_width,
+			.height = config.coded_height,
+			.bitrate_kbps = (long)(config.bitrate / 1000),
+		};
+		if (rendition.bitrate_kbps == 0) {
+			rendition.bitrate_kbps = (long)((uint64_t)rendition.width * rendition.height *
+							RENDITION_ESTIMATE_BITS_PER_PIXEL_SECOND / 1000);
+		}
+
+		// Keep sorted by bitrate; catalog order breaks ties
+		size_t pos = count++;
+		while (pos > 0 && renditions[pos - 1].bitrate_kbps > rendition.bitrate_kbps) {
+			renditions[pos] = renditions[pos - 1];
+			pos--;
+		}
+		renditions[pos] = rendition;
+	}
+
+	return count;
+}
+#else
+// This libmoq has no per-track details in the catalog, so there is nothing to choose
+// between and the first video track is used
+static size_t read_video_renditions(int32_t catalog_id, struct video_rendition *renditions)
+{
+	UNUSED_PARAMETER(catalog_id);
+	UNUSED_PARAMETER(renditions);
+	return 0;
+}
+#endif
+
+#ifdef HAVE_MOQ_AUDIO_CONFIG
+// Match the audio decoder to the first audio track's codec, rate and channels.
+// Caller holds decoder_mutex.
+static void configure_audio_decoder(struct hang_source *context, int32_t catalog_id)
+{
+	struct AudioConfig config = {0};
+	if (moq_consume_audio_config(catalog_id, 0, &config) < 0 || !config.codec) {
+		// No audio details for this track; keep whatever decoder is open
+		return;
+	}
+
+	audio_decoder_configure(context, config.codec, config.codec_len, config.sample_rate, config.channel_count);
+}
+#else
+// This libmoq has no audio details in the catalog, so the default Opus decoder stays
+static void configure_audio_decoder(struct hang_source *context, int32_t catalog_id)
+{
+	UNUSED_PARAMETER(context);
+	UNUSED_PARAMETER(catalog_id);
+}
+#endif
+
+static void subscribe_video_track(struct hang_source *context)
+{
+	// Best rendition under the bandwidth ceiling; the first track when the catalog has no bitrates
+	pthread_mutex_lock(&context->decoder_mutex);
+	size_t selected = bandwidth_select_rendition(context->renditions, context->rendition_count,
+						     context->rendition_ceiling_kbps);
+	uint32_t index = context->rendition_count > 0 ? context->renditions[selected].index : 0;
+	context->rendition_selected = selected;
+	// A new subscription starts mid-stream for the decoder; rejoin at its first keyframe
+	nvdec_decoder_resync(context);
+	congestion_policy_video_track_changed(&context->congestion);
+	pthread_mutex_unlock(&context->decoder_mutex);
+
+	// Subscribe with 100ms latency
+	context->video_track_id = moq_consume_video_track(
+		context->broadcast_id,
+		index,
+		100,   // 100ms latency
+		on_video_frame,
+		context
+	);
+	if (context->video_track_id <= 0) {
+		obs_log(LOG_WARNING, "Failed to subscribe to video track: %d", context->video_track_id);
+	} else {
+		obs_log(LOG_INFO, "Subscribed to video track %u: %d", index, context->video_track_id);
+	}
+}
+
+void hang_source_set_rendition_ceiling(struct hang_source *context, long ceiling_kbps)
+{
+	// Called from the allocator thread; the switch must not race deactivation or a catalog update
+	pthread_mutex_lock(&context->session_mutex);
+
+	pthread_mutex_lock(&context->decoder_mutex);
+	context->rendition_ceiling_kbps = ceiling_kbps;
+	size_t selected = bandwidth_select_rendition(context->renditions, context->rendition_count, ceiling_kbps);
+	bool switch_track = context->rendition_count > 1 && selected != context->rendition_selected;
+	pthread_mutex_unlock(&context->decoder_mutex);
+
+	// While video is dropped for congestion the ceiling applies at the next subscribe
+	if (switch_track && context->active && context->broadcast_id > 0 && context->video_track_id > 0) {
+		obs_log(LOG_INFO, "Switching video rendition for a %ld kbps ceiling", ceiling_kbps);
+		moq_consume_video_track_close(context->video_track_id);
+		context->video_track_id = 0;
+		subscribe_video_track(context);
+	}
+
+	pthread_mutex_unlock(&context->session_mutex);
 }
 
 static void on_video_frame(void *user_data, int32_t frame_id)
@@ -591,6 +1114,8 @@ static void on_video_frame(void *user_data, int32_t frame_id)
 		return;
 	}
 
+	os_atomic_inc_long(&context->video_frames_received);
+
 	// Get frame data from libmoq
 	struct Frame frame = {0};
 	int32_t result = moq_consume_frame_chunk(frame_id, 0, &frame);
@@ -610,9 +1135,19 @@ static void on_video_frame(void *user_data, int32_t frame_id)
 		return;
 	}
 
+	context->bytes_received += frame.payload_size;
+
+	// Frames still arriving after the congestion policy dropped video are skipped
+	if (!congestion_policy_on_video_frame(&context->congestion, frame.timestamp_us, os_gettime_ns())) {
+		pthread_mutex_unlock(&context->decoder_mutex);
+		moq_consume_frame_close(frame_id);
+		return;
+	}
+
 	// Decode video frame using software decoder (or NVDEC on Linux)
 	if (nvdec_decoder_decode(context, frame.payload, frame.payload_size, frame.timestamp_us, frame.keyframe)) {
 		// Frame was decoded and queued
+		os_atomic_inc_long(&context->video_frames_decoded);
 	}
 
 	pthread_mutex_unlock(&context->decoder_mutex);
@@ -638,6 +1173,8 @@ static void on_audio_frame(void *user_data, int32_t frame_id)
 		return;
 	}
 
+	os_atomic_inc_long(&context->audio_frames_received);
+
 	// Get frame data from libmoq
 	struct Frame frame = {0};
 	int32_t result = moq_consume_frame_chunk(frame_id, 0, &frame);
@@ -657,8 +1194,16 @@ static void on_audio_frame(void *user_data, int32_t frame_id)
 		return;
 	}
 
-	// Decode audio frame using FFmpeg
-	if (audio_decoder_decode(context, frame.payload, frame.payload_size, frame.timestamp_us)) {
+	context->bytes_received += frame.payload_size;
+
+	// Audio timing drives the congestion policy, since it keeps flowing when video is dropped
+	enum congestion_action action =
+		congestion_policy_on_audio_frame(&context->congestion, frame.timestamp_us, os_gettime_ns());
+
+	// Muted or off program with monitoring off: keep timing, skip the decode
+	if (os_atomic_load_bool(&context->audio_skip)) {
+		audio_decoder_skip(context);
+	} else if (audio_decoder_decode(context, frame.payload, frame.payload_size, frame.timestamp_us)) {
 		// Audio was decoded and queued
 	}
 
@@ -666,5 +1211,24 @@ static void on_audio_frame(void *user_data, int32_t frame_id)
 
 	// Release the frame
 	moq_consume_frame_close(frame_id);
+
+	if (action == CONGESTION_ACTION_NONE) {
+		return;
+	}
+
+	// Apply subscription changes outside the decoder lock, under the same lock as
+	// every other subscribe and unsubscribe
+	pthread_mutex_lock(&context->session_mutex);
+	if (action == CONGESTION_ACTION_DROP_VIDEO) {
+		if (context->video_track_id > 0) {
+			moq_consume_video_track_close(context->video_track_id);
+			context->video_track_id = 0;
+		}
+	} else if (action == CONGESTION_ACTION_RESTORE_VIDEO) {
+		if (context->active && context->broadcast_id > 0 && context->video_track_id <= 0) {
+			subscribe_video_track(context);
+		}
+	}
+	pthread_mutex_unlock(&context->session_mutex);
 }
 
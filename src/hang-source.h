@@ -21,9 +21,14 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <pthread.h>
 
+#include "congestion-policy.h"
+#include "bandwidth-allocator.h"
+#include "frame-outputs.h"
+
 // Forward declarations for decoder contexts
 struct nvdec_decoder;
 struct audio_decoder;
+struct frame_pacer;
 
 // Hang source context structure
 struct hang_source {
@@ -32,19 +37,27 @@ struct hang_source {
 	// Settings
 	char *url;
 	char *broadcast_path;
+	char *relay_url;
+	bool audio_first;
+	bool conceal_errors;
+	bool resync_on_loss; // Wait for a keyframe after lost frames (protected by decoder_mutex)
+	bool decode_out_of_process;
 
 	// MoQ resources (new API)
 	int32_t origin_id;
 	int32_t session_id;
+	int32_t announced_id;
 	int32_t broadcast_id;
 	int32_t catalog_consumer_id;
 	int32_t video_track_id;
 	int32_t audio_track_id;
 
+	// Optional re-publish to a second relay, open while the broadcast is subscribed.
+	// The relay origin holds only the subscribed broadcast.
+	int32_t relay_origin_id;
+	int32_t relay_session_id;
+
 	// Video state
-	gs_texture_t *texture;
-	uint32_t width;
-	uint32_t height;
 	enum video_format format;
 
 	// Audio state
@@ -52,6 +65,12 @@ struct hang_source {
 	enum audio_format audio_format;
 	uint32_t sample_rate;
 
+	// Whether anyone hears the audio, from the source's signals
+	bool audio_muted;         // Mixer mute
+	bool audio_on_program;    // Between the "activate" and "deactivate" signals
+	bool audio_monitored;     // Monitoring type other than none
+	volatile bool audio_skip; // Nobody hears this source; skip decode (atomic)
+
 	// Threading
 	pthread_mutex_t frame_mutex;
 	pthread_cond_t frame_cond;
@@ -65,20 +84,49 @@ struct hang_source {
 	size_t audio_queue_len;
 	size_t audio_queue_cap;
 
+	// Serializes activation and every subscribe/unsubscribe of the MoQ handles above,
+	// which happen on the UI, MoQ callback and allocator threads (recursive)
+	pthread_mutex_t session_mutex;
+
 	// Decoders
 	struct nvdec_decoder *nvdec_context;
 	struct audio_decoder *audio_decoder_context;
 	pthread_mutex_t decoder_mutex; // Protects decoder access during callbacks
 
-	// Decoded frame storage
-	uint8_t *current_frame_data;
-	size_t current_frame_size;
-	uint32_t current_frame_width;
+	// Congestion handling (protected by decoder_mutex)
+	struct congestion_policy congestion;
+
+	// Video renditions from the catalog, sorted by bitrate, and the bandwidth allocator's
+	// ceiling for choosing between them (protected by decoder_mutex)
+	struct video_rendition renditions[MAX_VIDEO_RENDITIONS];
+	size_t rendition_count;
+	size_t rendition_selected;
+	long rendition_ceiling_kbps; // 0 = unlimited
+	uint64_t bytes_received;     // Audio and video payload, for throughput estimates
+
+	// Decoded frame storage (protected by frame_mutex)
+	uint32_t current_frame_width; // Full decoded size, which is the source size in OBS
 	uint32_t current_frame_height;
+	uint64_t current_frame_id;           // Increments for every presented frame
+	uint64_t current_frame_timestamp_us; // MoQ timestamp of the presented frame
+	struct frame_output outputs[FRAME_OUTPUT_LEVELS];
+	uint32_t wanted_levels; // Output levels renders asked for since the last tick (bitmask)
+
+	// Presentation stage: picks which decoded frame each OBS tick shows
+	struct frame_pacer *pacer;
 
 	// Running state
 	bool active;
+
+	// Delivery statistics (atomic)
+	volatile long video_frames_received;
+	volatile long video_frames_decoded;
+	volatile long audio_frames_received;
+	volatile long catalog_updates;
 };
 
 // Declare the hang source info structure
 extern struct obs_source_info hang_source_info;
+
+// Limit video to renditions at or below this bitrate (0 = unlimited), switching tracks if needed
+void hang_source_set_rendition_ceiling(struct hang_source *context, long ceiling_kbps);
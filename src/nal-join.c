@@ -0,0 +1,206 @@
+/*
+H.264 Join Point Detection for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <plugin-support.h>
+
+#include "nal-join.h"
+
+// H.264 NAL unit and SEI payload types used to find join points
+#define H264_NAL_IDR_SLICE 5
+#define H264_NAL_SEI 6
+#define H264_SEI_RECOVERY_POINT 6
+
+// Reads RBSP bytes straight out of a NAL unit, dropping emulation prevention bytes as it
+// goes, so SEI payloads of any size can be walked without copying them
+struct rbsp_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	int zeros;
+
+	// RBSP bytes read so far, and how many may be read before the current payload ends
+	size_t read;
+	size_t limit;
+
+	uint8_t byte;
+	int bits_left;
+};
+
+static bool rbsp_read_byte(struct rbsp_reader *reader, uint8_t *value)
+{
+	if (reader->read >= reader->limit) {
+		return false;
+	}
+	if (reader->zeros >= 2 && reader->pos < reader->size && reader->data[reader->pos] == 0x03) {
+		reader->pos++;
+		reader->zeros = 0;
+	}
+	if (reader->pos >= reader->size) {
+		return false;
+	}
+
+	*value = reader->data[reader->pos++];
+	reader->zeros = *value == 0x00 ? reader->zeros + 1 : 0;
+	reader->read++;
+	return true;
+}
+
+static bool rbsp_read_bit(struct rbsp_reader *reader, uint32_t *bit)
+{
+	if (reader->bits_left == 0) {
+		if (!rbsp_read_byte(reader, &reader->byte)) {
+			return false;
+		}
+		reader->bits_left = 8;
+	}
+
+	reader->bits_left--;
+	*bit = (reader->byte >> reader->bits_left) & 1;
+	return true;
+}
+
+// Read an unsigned Exp-Golomb value
+static bool rbsp_read_ue(struct rbsp_reader *reader, uint32_t *value)
+{
+	int leading_zeros = 0;
+	uint32_t bit = 0;
+	while (true) {
+		if (leading_zeros > 31 || !rbsp_read_bit(reader, &bit)) {
+			return false;
+		}
+		if (bit) {
+			break;
+		}
+		leading_zeros++;
+	}
+
+	uint32_t suffix = 0;
+	for (int i = 0; i < leading_zeros; i++) {
+		if (!rbsp_read_bit(reader, &bit)) {
+			return false;
+		}
+		suffix = (suffix << 1) | bit;
+	}
+
+	*value = (uint32_t)((1ULL << leading_zeros) - 1 + suffix);
+	return true;
+}
+
+// SEI type and size fields: a run of 0xFF bytes, each adding 255, then the final byte
+static bool rbsp_read_sei_value(struct rbsp_reader *reader, uint32_t *value)
+{
+	uint8_t byte = 0;
+	*value = 0;
+	while (rbsp_read_byte(reader, &byte)) {
+		if (byte != 0xFF) {
+			*value += byte;
+			return true;
+		}
+		*value += 255;
+	}
+	return false;
+}
+
+// Only the rbsp_trailing_bits byte, and possibly zero padding, remain
+static bool rbsp_trailing(const struct rbsp_reader *reader)
+{
+	if (reader->pos >= reader->size) {
+		return true;
+	}
+	if (reader->data[reader->pos] != 0x80) {
+		return false;
+	}
+	for (size_t i = reader->pos + 1; i < reader->size; i++) {
+		if (reader->data[i] != 0x00) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Walk every SEI message header in the NAL and read recovery_frame_cnt in place
+static void parse_sei_recovery_point(const uint8_t *nal, size_t nal_size, struct nal_join_info *join)
+{
+	struct rbsp_reader reader = {.data = nal + 1, .size = nal_size - 1, .limit = SIZE_MAX};
+
+	while (!rbsp_trailing(&reader)) {
+		uint32_t payload_type = 0;
+		uint32_t payload_size = 0;
+		if (!rbsp_read_sei_value(&reader, &payload_type) || !rbsp_read_sei_value(&reader, &payload_size)) {
+			return;
+		}
+
+		// Escaped bytes only shrink the RBSP, so a payload larger than the raw bytes left is truncated
+		if (payload_size > reader.size - reader.pos) {
+			return;
+		}
+
+		reader.limit = reader.read + payload_size;
+		if (payload_type == H264_SEI_RECOVERY_POINT) {
+			uint32_t recovery_frame_cnt = 0;
+			if (rbsp_read_ue(&reader, &recovery_frame_cnt)) {
+				join->recovery_point = true;
+				join->recovery_frame_cnt = recovery_frame_cnt;
+			}
+			return;
+		}
+
+		// Skip payloads we do not need; a payload running past the NAL ends the walk
+		uint8_t byte = 0;
+		while (reader.read < reader.limit) {
+			if (!rbsp_read_byte(&reader, &byte)) {
+				return;
+			}
+		}
+		reader.limit = SIZE_MAX;
+	}
+}
+
+void nal_join_scan(const uint8_t *nal, size_t nal_size, struct nal_join_info *join)
+{
+	if (nal_size == 0) {
+		return;
+	}
+
+	uint8_t nal_type = nal[0] & 0x1F;
+	if (nal_type == H264_NAL_IDR_SLICE) {
+		join->idr = true;
+	} else if (nal_type == H264_NAL_SEI && !join->recovery_point) {
+		parse_sei_recovery_point(nal, nal_size, join);
+	}
+}
+
+bool nal_join_gate(bool *synced, uint32_t *refresh_frames_left, bool keyframe, const struct nal_join_info *join)
+{
+	if (*synced) {
+		return true;
+	}
+
+	// Intra-refresh streams may never send IDR frames, so a recovery point SEI is accepted
+	// too, with output held back until the refresh has swept the whole picture
+	if (keyframe || join->idr) {
+		*synced = true;
+		*refresh_frames_left = 0;
+	} else if (join->recovery_point) {
+		*synced = true;
+		*refresh_frames_left = join->recovery_frame_cnt;
+		obs_log(LOG_INFO, "Joining at recovery point, refresh completes in %u frames", join->recovery_frame_cnt);
+	}
+	return *synced;
+}
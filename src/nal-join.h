@@ -0,0 +1,38 @@
+/*
+H.264 Join Point Detection for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Join points found while walking the NAL units of an H.264 access unit
+struct nal_join_info {
+	bool idr;
+	bool recovery_point;
+	uint32_t recovery_frame_cnt;
+};
+
+// Note the join point one NAL unit (header byte included, no start code) provides.
+// SEI messages are read in place, so a recovery point anywhere in the NAL is found.
+void nal_join_scan(const uint8_t *nal, size_t nal_size, struct nal_join_info *join);
+
+// Decide whether an access unit may be decoded. Until synced, only an IDR or a recovery
+// point is accepted; joining at a recovery point sets how many pictures to keep hidden.
+bool nal_join_gate(bool *synced, uint32_t *refresh_frames_left, bool keyframe, const struct nal_join_info *join);
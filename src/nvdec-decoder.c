@@ -22,7 +22,6 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <graphics/graphics.h>
 #include <libavutil/frame.h>
 #include <libavcodec/avcodec.h>
-#include <libswscale/swscale.h>
 
 // FFmpeg headers for hardware acceleration
 #include <libavcodec/avcodec.h>
@@ -32,25 +31,53 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #endif
 
 #include "hang-source.h"
+#include "nvdec-decoder.h"
+#include "frame-pacer.h"
+#include "nal-join.h"
+#include "frame-gap.h"
+#ifdef HAVE_DECODE_HOSTS
+#include "decode-host-client.h"
+#endif
 
 // Function declarations
+static bool open_in_process(struct nvdec_decoder *decoder);
 static bool nvdec_init_cuda_decoder(struct nvdec_decoder *decoder);
 static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *data, size_t size, uint64_t pts, struct hang_source *context);
 static bool software_decode_frame(struct nvdec_decoder *decoder, const uint8_t *data, size_t size, uint64_t pts, struct hang_source *context);
-static void store_decoded_frame(struct hang_source *context, uint8_t *data, size_t size, uint32_t width, uint32_t height);
-static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, uint8_t **out_data, size_t *out_size);
+static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, uint8_t **out_data, size_t *out_size,
+					     struct nal_join_info *join);
+static bool output_suppressed(struct nvdec_decoder *decoder);
+static void configure_error_concealment(struct nvdec_decoder *decoder);
+static bool frame_corrupt(struct nvdec_decoder *decoder, const AVFrame *frame);
 
 struct nvdec_decoder {
 	// FFmpeg hardware acceleration context
 	AVBufferRef *hw_device_ctx;
 	AVCodecContext *codec_ctx;
-	struct SwsContext *sws_ctx;
 
 	// Video format information
 	uint32_t width;
 	uint32_t height;
 	enum AVPixelFormat pix_fmt;
 
+	// Join state: nothing is decoded until an IDR or recovery point arrives,
+	// and output stays hidden until an intra refresh has covered the picture
+	bool synced;
+	uint32_t refresh_frames_left;
+
+	// Loss handling: by default frames are decoded straight through gaps. Optionally
+	// rejoin at the next keyframe after a gap, or decode with error concealment until
+	// corruption persists too long.
+	bool conceal_errors;
+	struct frame_gap gap;
+	uint32_t corrupt_frames;
+
+#ifdef HAVE_DECODE_HOSTS
+	// Out-of-process decoding: this side only prepares and gates packets
+	struct decode_host_client *host;
+	bool host_flush_pending;
+#endif
+
 	// Reference to parent context for frame storage
 	struct hang_source *context;
 };
@@ -59,8 +86,33 @@ bool nvdec_decoder_init(struct hang_source *context)
 {
 	struct nvdec_decoder *decoder = bzalloc(sizeof(struct nvdec_decoder));
 	decoder->context = context;
+	decoder->conceal_errors = context->conceal_errors;
+	frame_gap_reset(&decoder->gap, FRAME_GAP_VIDEO_REORDER);
+	// Set before any return so nvdec_decoder_destroy always finds the decoder and its host
 	context->nvdec_context = decoder;
 
+#ifdef HAVE_DECODE_HOSTS
+	if (context->decode_out_of_process) {
+		decoder->host = decode_host_client_start(context, decoder->conceal_errors);
+		if (decoder->host) {
+			obs_log(LOG_INFO, "Decoding in a separate host process");
+			return true;
+		}
+		obs_log(LOG_WARNING, "Decode host unavailable, decoding in process");
+	}
+#endif
+
+	if (!open_in_process(decoder)) {
+		bfree(decoder);
+		context->nvdec_context = NULL;
+		return false;
+	}
+	return true;
+}
+
+// Open a CUDA decoder, or FFmpeg's software decoder if that fails
+static bool open_in_process(struct nvdec_decoder *decoder)
+{
 	// Try to initialize CUDA hardware acceleration with FFmpeg
 	if (!nvdec_init_cuda_decoder(decoder)) {
 		obs_log(LOG_WARNING, "CUDA hardware acceleration initialization failed, falling back to software decoding");
@@ -78,24 +130,20 @@ software_fallback:
 	const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
 	if (!codec) {
 		obs_log(LOG_ERROR, "H.264 codec not found");
-		bfree(decoder);
-		context->nvdec_context = NULL;
 		return false;
 	}
 
 	decoder->codec_ctx = avcodec_alloc_context3(codec);
 	if (!decoder->codec_ctx) {
 		obs_log(LOG_ERROR, "Failed to allocate codec context");
-		bfree(decoder);
-		context->nvdec_context = NULL;
 		return false;
 	}
 
+	configure_error_concealment(decoder);
+
 	if (avcodec_open2(decoder->codec_ctx, codec, NULL) < 0) {
 		obs_log(LOG_ERROR, "Failed to open codec");
 		avcodec_free_context(&decoder->codec_ctx);
-		bfree(decoder);
-		context->nvdec_context = NULL;
 		return false;
 	}
 
@@ -111,6 +159,11 @@ void nvdec_decoder_destroy(struct hang_source *context)
 		return;
 	}
 
+#ifdef HAVE_DECODE_HOSTS
+	decode_host_client_stop(decoder->host);
+	decoder->host = NULL;
+#endif
+
 	if (decoder->codec_ctx) {
 		avcodec_free_context(&decoder->codec_ctx);
 		decoder->codec_ctx = NULL;
@@ -121,31 +174,163 @@ void nvdec_decoder_destroy(struct hang_source *context)
 		decoder->hw_device_ctx = NULL;
 	}
 
-	if (decoder->sws_ctx) {
-		sws_freeContext(decoder->sws_ctx);
-		decoder->sws_ctx = NULL;
-	}
-
 	bfree(decoder);
 	context->nvdec_context = NULL;
 }
 
+void nvdec_decoder_resync(struct hang_source *context)
+{
+	struct nvdec_decoder *decoder = context->nvdec_context;
+	if (!decoder) {
+		return;
+	}
+
+	// Drop references to skipped frames and wait for the next IDR or recovery point
+	if (decoder->codec_ctx) {
+		avcodec_flush_buffers(decoder->codec_ctx);
+	}
+#ifdef HAVE_DECODE_HOSTS
+	decoder->host_flush_pending = true;
+#endif
+	decoder->synced = false;
+	decoder->refresh_frames_left = 0;
+	decoder->corrupt_frames = 0;
+
+	// The next frames may come from another track or after a long pause; learn their timing afresh
+	frame_gap_reset(&decoder->gap, FRAME_GAP_VIDEO_REORDER);
+}
+
 bool nvdec_decoder_decode(struct hang_source *context, const uint8_t *data, size_t size, uint64_t pts, bool keyframe)
 {
-	UNUSED_PARAMETER(keyframe);
 	struct nvdec_decoder *decoder = context->nvdec_context;
 	if (!decoder) {
 		return false;
 	}
 
+#ifdef HAVE_DECODE_HOSTS
+	// The host kept crashing; rather than leave the source blank, decode here from now on
+	if (decoder->host && decode_host_client_failed(decoder->host)) {
+		decode_host_client_stop(decoder->host);
+		decoder->host = NULL;
+		obs_log(LOG_WARNING, "Decode host given up on, switching to in-process decoding");
+		if (!open_in_process(decoder)) {
+			obs_log(LOG_ERROR, "In-process decoding unavailable too, video stopped");
+		}
+		nvdec_decoder_resync(context);
+	}
+
+	// The host crashed, dropped input or gave up on concealment
+	if (decoder->host && decode_host_client_take_resync(decoder->host)) {
+		nvdec_decoder_resync(context);
+	}
+	if (!decoder->codec_ctx && !decoder->host) {
+		return false;
+	}
+#else
+	if (!decoder->codec_ctx) {
+		return false;
+	}
+#endif
+
+	// For MP4 H.264 (avc1), convert length-prefixed NAL units to start-code format
+	uint8_t *converted_data = NULL;
+	size_t converted_size = 0;
+	struct nal_join_info join = {0};
+
+	if (!convert_mp4_nal_units_to_annex_b(data, size, &converted_data, &converted_size, &join)) {
+		obs_log(LOG_ERROR, "Failed to convert NAL units");
+		return false;
+	}
+
+	// Lost frames break the reference chain. Only when the source opts in, rejoin at
+	// the next keyframe; with concealment, keep decoding and let corruption tracking decide.
+	bool lost = frame_gap_push(&decoder->gap, pts) > 0;
+	if (lost && decoder->synced && context->resync_on_loss && !decoder->conceal_errors) {
+		obs_log(LOG_DEBUG, "Frame gap detected, waiting for next keyframe");
+		nvdec_decoder_resync(context);
+	}
+
+	// Wait for a clean join point
+	if (!nal_join_gate(&decoder->synced, &decoder->refresh_frames_left, keyframe, &join)) {
+		bfree(converted_data);
+		return false;
+	}
+
+	bool decoded;
+
+#ifdef HAVE_DECODE_HOSTS
+	if (decoder->host) {
+		// Output suppression for the refresh period happens in the host
+		decoded = decode_host_client_submit(decoder->host, converted_data, converted_size, pts,
+						    decoder->refresh_frames_left, decoder->host_flush_pending);
+		decoder->refresh_frames_left = 0;
+		decoder->host_flush_pending = false;
+		bfree(converted_data);
+		return decoded;
+	}
+#endif
+
 	// Try CUDA hardware acceleration first, fallback to software
-	if (decoder->hw_device_ctx && decoder->codec_ctx) {
-		return nvdec_decode_frame(decoder, data, size, pts, context);
-	} else if (decoder->codec_ctx) {
-		return software_decode_frame(decoder, data, size, pts, context);
+	if (decoder->hw_device_ctx) {
+		decoded = nvdec_decode_frame(decoder, converted_data, converted_size, pts, context);
 	} else {
+		decoded = software_decode_frame(decoder, converted_data, converted_size, pts, context);
+	}
+
+	bfree(converted_data);
+	return decoded;
+}
+
+static void configure_error_concealment(struct nvdec_decoder *decoder)
+{
+	if (!decoder->conceal_errors) {
+		return;
+	}
+
+	// Guess motion vectors for missing macroblocks and keep outputting damaged pictures
+	decoder->codec_ctx->error_concealment = FF_EC_GUESS_MVS | FF_EC_DEBLOCK | FF_EC_FAVOR_INTER;
+	decoder->codec_ctx->flags |= AV_CODEC_FLAG_OUTPUT_CORRUPT;
+	decoder->codec_ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
+	obs_log(LOG_INFO, "Error concealment enabled for lossy decode");
+}
+
+// Track picture corruption; returns true if the frame should not be shown
+static bool frame_corrupt(struct nvdec_decoder *decoder, const AVFrame *frame)
+{
+	bool corrupt = frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT);
+
+	if (!corrupt) {
+		if (decoder->corrupt_frames > 0) {
+			obs_log(LOG_DEBUG, "Picture clean again after %u corrupt frames", decoder->corrupt_frames);
+		}
+		decoder->corrupt_frames = 0;
 		return false;
 	}
+
+	if (!decoder->conceal_errors) {
+		return false;
+	}
+
+	// Concealed artifacts are acceptable for a while, but not indefinitely
+	if (++decoder->corrupt_frames >= CONCEAL_MAX_CORRUPT_FRAMES) {
+		obs_log(LOG_WARNING, "Corruption persisted for %u frames, waiting for next keyframe",
+			decoder->corrupt_frames);
+		nvdec_decoder_resync(decoder->context);
+		return true;
+	}
+
+	return false;
+}
+
+// Hide partially refreshed pictures after joining at a recovery point
+static bool output_suppressed(struct nvdec_decoder *decoder)
+{
+	if (decoder->refresh_frames_left == 0) {
+		return false;
+	}
+
+	decoder->refresh_frames_left--;
+	return true;
 }
 
 // Initialize CUDA hardware acceleration with FFmpeg
@@ -190,6 +375,8 @@ static bool nvdec_init_cuda_decoder(struct nvdec_decoder *decoder)
 		decoder->codec_ctx->extra_hw_frames = 1;
 	}
 
+	configure_error_concealment(decoder);
+
 	// Open the codec
 	ret = avcodec_open2(decoder->codec_ctx, codec, NULL);
 	if (ret < 0) {
@@ -216,24 +403,14 @@ static bool nvdec_init_cuda_decoder(struct nvdec_decoder *decoder)
 #ifdef HAVE_NVDEC
 static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *data, size_t size, uint64_t pts, struct hang_source *context)
 {
-	// Convert MP4 NAL units to Annex B format
-	uint8_t *converted_data = NULL;
-	size_t converted_size = 0;
-
-	if (!convert_mp4_nal_units_to_annex_b(data, size, &converted_data, &converted_size)) {
-		obs_log(LOG_ERROR, "Failed to convert NAL units");
-		return false;
-	}
-
 	AVPacket *packet = av_packet_alloc();
 	if (!packet) {
 		obs_log(LOG_ERROR, "Failed to allocate AVPacket");
-		bfree(converted_data);
 		return false;
 	}
 
-	packet->data = converted_data;
-	packet->size = converted_size;
+	packet->data = (uint8_t *)data;
+	packet->size = (int)size;
 	packet->pts = pts;
 
 	int ret = avcodec_send_packet(decoder->codec_ctx, packet);
@@ -241,14 +418,12 @@ static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *dat
 
 	if (ret < 0) {
 		obs_log(LOG_ERROR, "Error sending packet to CUDA decoder: %s", av_err2str(ret));
-		bfree(converted_data);
 		return false;
 	}
 
 	AVFrame *frame = av_frame_alloc();
 	if (!frame) {
 		obs_log(LOG_ERROR, "Failed to allocate AVFrame");
-		bfree(converted_data);
 		return false;
 	}
 
@@ -258,7 +433,12 @@ static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *dat
 			obs_log(LOG_ERROR, "Error receiving frame from CUDA decoder: %s", av_err2str(ret));
 		}
 		av_frame_free(&frame);
-		bfree(converted_data);
+		return false;
+	}
+
+	// Still refreshing after a recovery point join, or concealment gave up; skip conversion entirely
+	if (frame_corrupt(decoder, frame) || output_suppressed(decoder)) {
+		av_frame_free(&frame);
 		return false;
 	}
 
@@ -269,67 +449,24 @@ static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *dat
 		if (!sw_frame) {
 			obs_log(LOG_ERROR, "Failed to allocate software frame");
 			av_frame_free(&frame);
-			bfree(converted_data);
 			return false;
 		}
 
 		sw_frame->format = AV_PIX_FMT_NV12; // Intermediate format
 		ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+		av_frame_copy_props(sw_frame, frame); // Keep the pts for pacing
 		av_frame_free(&frame);
 		frame = sw_frame;
 
 		if (ret < 0) {
 			obs_log(LOG_ERROR, "Failed to transfer frame from GPU to CPU: %s", av_err2str(ret));
 			av_frame_free(&frame);
-			bfree(converted_data);
 			return false;
 		}
 	}
 
-	// Convert to RGBA for OBS
-	if (!decoder->sws_ctx) {
-		decoder->sws_ctx = sws_getContext(
-			frame->width, frame->height, (enum AVPixelFormat)frame->format,
-			frame->width, frame->height, AV_PIX_FMT_RGBA,
-			SWS_BILINEAR | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT, NULL, NULL, NULL);
-		if (!decoder->sws_ctx) {
-			obs_log(LOG_ERROR, "Failed to create SWS context");
-			av_frame_free(&frame);
-			bfree(converted_data);
-			return false;
-		}
-	}
-
-	// Allocate buffer for RGBA data
-	size_t rgba_size = frame->width * frame->height * 4;
-	uint8_t *rgba_data = bzalloc(rgba_size);
-	if (!rgba_data) {
-		obs_log(LOG_ERROR, "Failed to allocate RGBA buffer");
-		av_frame_free(&frame);
-		bfree(converted_data);
-		return false;
-	}
-
-	// Convert frame to RGBA
-	uint8_t *dst_data[4] = {rgba_data, NULL, NULL, NULL};
-	int dst_linesize[4] = {frame->width * 4, 0, 0, 0};
-
-	int scale_ret = sws_scale(decoder->sws_ctx, (const uint8_t * const *)frame->data, frame->linesize,
-	          0, frame->height, dst_data, dst_linesize);
-
-	if (scale_ret < 0) {
-		obs_log(LOG_ERROR, "sws_scale failed: %s", av_err2str(ret));
-		bfree(rgba_data);
-		av_frame_free(&frame);
-		bfree(converted_data);
-		return false;
-	}
-
-	// Store the decoded frame
-	store_decoded_frame(context, rgba_data, rgba_size, frame->width, frame->height);
-
-	av_frame_free(&frame);
-	bfree(converted_data);
+	// Hand the picture to the presentation stage; only frames it selects get converted
+	frame_pacer_push(context->pacer, frame);
 	return true;
 }
 #else
@@ -345,7 +482,8 @@ static bool nvdec_decode_frame(struct nvdec_decoder *decoder, const uint8_t *dat
 }
 #endif
 
-static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, uint8_t **out_data, size_t *out_size)
+static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, uint8_t **out_data, size_t *out_size,
+					     struct nal_join_info *join)
 {
 	// Estimate output size (add 4 bytes for each start code, remove 4 bytes for each length)
 	size_t estimated_size = size + 1024; // Add some padding
@@ -379,6 +517,9 @@ static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, u
 			buffer = new_buffer;
 		}
 
+		// Note join points while walking the access unit
+		nal_join_scan(data + pos, nal_length, join);
+
 		// Write start code
 		buffer[out_pos++] = 0x00;
 		buffer[out_pos++] = 0x00;
@@ -398,25 +539,14 @@ static bool convert_mp4_nal_units_to_annex_b(const uint8_t *data, size_t size, u
 
 static bool software_decode_frame(struct nvdec_decoder *decoder, const uint8_t *data, size_t size, uint64_t pts, struct hang_source *context)
 {
-
-	// For MP4 H.264 (avc1), convert length-prefixed NAL units to start-code format
-	uint8_t *converted_data = NULL;
-	size_t converted_size = 0;
-
-	if (!convert_mp4_nal_units_to_annex_b(data, size, &converted_data, &converted_size)) {
-		obs_log(LOG_ERROR, "Failed to convert NAL units");
-		return false;
-	}
-
 	AVPacket *packet = av_packet_alloc();
 	if (!packet) {
 		obs_log(LOG_ERROR, "Failed to allocate AVPacket");
-		bfree(converted_data);
 		return false;
 	}
 
-	packet->data = converted_data;
-	packet->size = converted_size;
+	packet->data = (uint8_t *)data;
+	packet->size = (int)size;
 	packet->pts = pts;
 
 	int ret = avcodec_send_packet(decoder->codec_ctx, packet);
@@ -425,14 +555,12 @@ static bool software_decode_frame(struct nvdec_decoder *decoder, const uint8_t *
 
 	if (ret < 0) {
 		obs_log(LOG_ERROR, "Error sending packet to decoder: %s", av_err2str(ret));
-		bfree(converted_data);
 		return false;
 	}
 
 	AVFrame *frame = av_frame_alloc();
 	if (!frame) {
 		obs_log(LOG_ERROR, "Failed to allocate AVFrame");
-		bfree(converted_data);
 		return false;
 	}
 
@@ -442,84 +570,16 @@ static bool software_decode_frame(struct nvdec_decoder *decoder, const uint8_t *
 			obs_log(LOG_ERROR, "Error receiving frame from decoder: %s", av_err2str(ret));
 		}
 		av_frame_free(&frame);
-		bfree(converted_data);
-		return false;
-	}
-
-	// Convert frame to RGBA for OBS
-	if (!decoder->sws_ctx) {
-		decoder->sws_ctx = sws_getContext(
-			frame->width, frame->height, (enum AVPixelFormat)frame->format,
-			frame->width, frame->height, AV_PIX_FMT_RGBA,
-			SWS_BILINEAR | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT, NULL, NULL, NULL);
-		if (!decoder->sws_ctx) {
-			obs_log(LOG_ERROR, "Failed to create SWS context");
-			av_frame_free(&frame);
-			return false;
-		}
-	}
-
-	// Allocate buffer for RGBA data
-	size_t rgba_size = frame->width * frame->height * 4; // 4 bytes per pixel for RGBA
-	uint8_t *rgba_data = bzalloc(rgba_size);
-	if (!rgba_data) {
-		obs_log(LOG_ERROR, "Failed to allocate RGBA buffer");
-		av_frame_free(&frame);
-		bfree(converted_data);
 		return false;
 	}
 
-	// Convert frame to RGBA
-	uint8_t *dst_data[4] = {rgba_data, NULL, NULL, NULL};
-	int dst_linesize[4] = {frame->width * 4, 0, 0, 0};
-
-	int scale_ret = sws_scale(decoder->sws_ctx, (const uint8_t * const *)frame->data, frame->linesize,
-	          0, frame->height, dst_data, dst_linesize);
-
-	if (scale_ret < 0) {
-		obs_log(LOG_ERROR, "sws_scale failed: %s", av_err2str(ret));
-		bfree(rgba_data);
+	// Still refreshing after a recovery point join, or concealment gave up; skip conversion entirely
+	if (frame_corrupt(decoder, frame) || output_suppressed(decoder)) {
 		av_frame_free(&frame);
-		bfree(converted_data);
 		return false;
 	}
 
-	// Store the decoded frame
-	store_decoded_frame(context, rgba_data, rgba_size, frame->width, frame->height);
-
-	av_frame_free(&frame);
-	bfree(converted_data);
+	// Hand the picture to the presentation stage; only frames it selects get converted
+	frame_pacer_push(context->pacer, frame);
 	return true;
 }
-
-static void store_decoded_frame(struct hang_source *context, uint8_t *data, size_t size, uint32_t width, uint32_t height)
-{
-	if (!context || !data) {
-		return;
-	}
-
-	pthread_mutex_lock(&context->frame_mutex);
-
-	// Check if source is still active before storing frame
-	// This prevents storing frames after deactivation has started cleanup
-	if (!context->active) {
-		pthread_mutex_unlock(&context->frame_mutex);
-		bfree(data); // Free the data we allocated since we're not using it
-		return;
-	}
-
-	// Free previous frame data
-	if (context->current_frame_data) {
-		bfree(context->current_frame_data);
-	}
-
-	// Store new frame data
-	context->current_frame_data = data;
-	context->current_frame_size = size;
-	context->current_frame_width = width;
-	context->current_frame_height = height;
-
-	pthread_mutex_unlock(&context->frame_mutex);
-}
-
-
@@ -24,7 +24,11 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 
 struct hang_source;
 
+// With error concealment, this many consecutive corrupt pictures escalate to a keyframe wait
+#define CONCEAL_MAX_CORRUPT_FRAMES 60
+
 // NVDEC decoder functions
 bool nvdec_decoder_init(struct hang_source *context);
 void nvdec_decoder_destroy(struct hang_source *context);
+void nvdec_decoder_resync(struct hang_source *context);
 bool nvdec_decoder_decode(struct hang_source *context, const uint8_t *data, size_t size, uint64_t pts, bool keyframe);
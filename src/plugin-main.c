@@ -20,6 +20,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <plugin-support.h>
 #include <moq.h>
 #include "hang-source.h"
+#include "bandwidth-allocator.h"
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
@@ -48,11 +49,15 @@ bool obs_module_load(void)
 	obs_register_source(&hang_source_info);
 	obs_log(LOG_INFO, "Hang source registered successfully");
 
+	// Shares link capacity between sources by what is on air
+	bandwidth_allocator_start();
+
 	obs_log(LOG_INFO, "Hang MoQ plugin loaded successfully");
 	return true;
 }
 
 void obs_module_unload(void)
 {
+	bandwidth_allocator_stop();
 	obs_log(LOG_INFO, "plugin unloaded");
 }
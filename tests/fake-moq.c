@@ -0,0 +1,879 @@
+/*
+In-Process MoQ Stand-In for Hang Source Tests
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <moq.h>
+
+#include "fake-moq.h"
+
+// Handles are a slot index plus a generation, so a stale or doubled close is caught
+// even after its slot has been reused
+#define MAX_HANDLES 65535
+#define HANDLE_GEN_SHIFT 16
+#define HANDLE_GEN_MAX 0x7fff
+
+#define MAX_RENDITIONS 8
+#define MAX_CALLBACKS 64
+
+typedef void (*fake_callback)(void *user_data, int32_t id);
+
+enum handle_kind {
+	HANDLE_FREE,
+	HANDLE_ORIGIN,
+	HANDLE_SESSION,
+	HANDLE_ANNOUNCED,      // moq_origin_announced watcher
+	HANDLE_ANNOUNCED_INFO, // Valid during an announcement callback
+	HANDLE_CONSUME,
+	HANDLE_CATALOG,          // moq_consume_catalog subscription
+	HANDLE_CATALOG_SNAPSHOT, // Valid during a catalog callback
+	HANDLE_VIDEO_TRACK,
+	HANDLE_AUDIO_TRACK,
+	HANDLE_FRAME,
+};
+
+struct handle {
+	enum handle_kind kind;
+	uint16_t gen;
+
+	char *str;       // Session url, consumed or announced path
+	int32_t origin;  // Session publish origin, or the origin a handle belongs to
+	int32_t origin2; // Session consume origin
+	int32_t parent;  // Consume handle of a catalog or track subscription
+	uint32_t index;  // Track index
+	bool active;     // Announcement state
+	fake_callback callback;
+	void *user_data;
+
+	struct Frame frame; // Payload is owned here
+};
+
+// A broadcast present in an origin
+struct announcement {
+	int32_t origin;
+	char *path;
+	int32_t source; // Consume handle re-published with moq_origin_publish, 0 for a publisher's own
+};
+
+// Catalog contents the publisher of a path offers
+struct broadcast {
+	char *path;
+	struct fake_moq_rendition renditions[MAX_RENDITIONS];
+	size_t rendition_count;
+	char *audio_codec; // NULL when the catalog lists no audio details
+	uint32_t audio_sample_rate;
+	uint32_t audio_channels;
+};
+
+struct url_count {
+	char *url;
+	size_t connects;
+	size_t closes;
+};
+
+struct pending_callback {
+	fake_callback callback;
+	void *user_data;
+	int32_t id;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	struct handle handles[MAX_HANDLES];
+	uint32_t free_list[MAX_HANDLES];
+	size_t free_len;
+	size_t used; // Slots handed out at least once
+
+	struct announcement *announcements;
+	size_t announcements_len;
+	struct broadcast *broadcasts;
+	size_t broadcasts_len;
+	struct url_count *urls;
+	size_t urls_len;
+
+	size_t bad_closes;
+} fake = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static char *copy_string(const char *str, size_t len)
+{
+	char *copy = malloc(len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+static bool same_string(const char *a, const char *b, size_t b_len)
+{
+	return a && strlen(a) == b_len && memcmp(a, b, b_len) == 0;
+}
+
+static int32_t handle_new(enum handle_kind kind)
+{
+	uint32_t slot;
+	if (fake.free_len > 0) {
+		slot = fake.free_list[--fake.free_len];
+	} else if (fake.used < MAX_HANDLES) {
+		slot = (uint32_t)fake.used++;
+	} else {
+		return -1;
+	}
+
+	struct handle *handle = &fake.handles[slot];
+	uint16_t gen = handle->gen == HANDLE_GEN_MAX ? 1 : handle->gen + 1;
+	memset(handle, 0, sizeof(*handle));
+	handle->kind = kind;
+	handle->gen = gen;
+	return (int32_t)(((uint32_t)gen << HANDLE_GEN_SHIFT) | (slot + 1));
+}
+
+static struct handle *handle_get(int32_t id, enum handle_kind kind)
+{
+	if (id <= 0) {
+		return NULL;
+	}
+
+	uint32_t slot = ((uint32_t)id & 0xffff) - 1;
+	uint16_t gen = (uint16_t)((uint32_t)id >> HANDLE_GEN_SHIFT);
+	if (slot >= fake.used) {
+		return NULL;
+	}
+
+	struct handle *handle = &fake.handles[slot];
+	if (handle->kind != kind || handle->gen != gen) {
+		return NULL;
+	}
+	return handle;
+}
+
+static void handle_free(int32_t id)
+{
+	uint32_t slot = ((uint32_t)id & 0xffff) - 1;
+	struct handle *handle = &fake.handles[slot];
+
+	free(handle->str);
+	free((void *)handle->frame.payload);
+	uint16_t gen = handle->gen;
+	memset(handle, 0, sizeof(*handle));
+	handle->gen = gen;
+	fake.free_list[fake.free_len++] = slot;
+}
+
+static int32_t handle_close(int32_t id, enum handle_kind kind)
+{
+	if (!handle_get(id, kind)) {
+		fake.bad_closes++;
+		return -1;
+	}
+	handle_free(id);
+	return 0;
+}
+
+static struct url_count *url_count_get(const char *url, size_t len)
+{
+	for (size_t i = 0; i < fake.urls_len; i++) {
+		if (same_string(fake.urls[i].url, url, len)) {
+			return &fake.urls[i];
+		}
+	}
+
+	fake.urls = realloc(fake.urls, sizeof(*fake.urls) * (fake.urls_len + 1));
+	struct url_count *count = &fake.urls[fake.urls_len++];
+	memset(count, 0, sizeof(*count));
+	count->url = copy_string(url, len);
+	return count;
+}
+
+static struct broadcast *broadcast_get(const char *path, size_t len)
+{
+	for (size_t i = 0; i < fake.broadcasts_len; i++) {
+		if (same_string(fake.broadcasts[i].path, path, len)) {
+			return &fake.broadcasts[i];
+		}
+	}
+
+	fake.broadcasts = realloc(fake.broadcasts, sizeof(*fake.broadcasts) * (fake.broadcasts_len + 1));
+	struct broadcast *broadcast = &fake.broadcasts[fake.broadcasts_len++];
+	memset(broadcast, 0, sizeof(*broadcast));
+	broadcast->path = copy_string(path, len);
+	return broadcast;
+}
+
+static bool origin_has(int32_t origin, const char *path, size_t len)
+{
+	for (size_t i = 0; i < fake.announcements_len; i++) {
+		if (fake.announcements[i].origin == origin && same_string(fake.announcements[i].path, path, len)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void origin_remove(int32_t origin, const char *path)
+{
+	for (size_t i = 0; i < fake.announcements_len; i++) {
+		struct announcement *announcement = &fake.announcements[i];
+		if (announcement->origin == origin && (!path || strcmp(announcement->path, path) == 0)) {
+			free(announcement->path);
+			fake.announcements[i--] = fake.announcements[--fake.announcements_len];
+		}
+	}
+}
+
+// Consume handles for this path whose origin still has it announced
+static bool consume_live(const struct handle *consume)
+{
+	return consume && origin_has(consume->origin, consume->str, strlen(consume->str));
+}
+
+// Present in an origin, and for a re-published broadcast, still live where it came from
+static bool origin_has_live(int32_t origin, const char *path, size_t len)
+{
+	for (size_t i = 0; i < fake.announcements_len; i++) {
+		const struct announcement *announcement = &fake.announcements[i];
+		if (announcement->origin != origin || !same_string(announcement->path, path, len)) {
+			continue;
+		}
+		if (announcement->source == 0 || consume_live(handle_get(announcement->source, HANDLE_CONSUME))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void run_callbacks(const struct pending_callback *pending, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		pending[i].callback(pending[i].user_data, pending[i].id);
+	}
+}
+
+// Borrowed handles only live for the duration of their callback
+static void free_borrowed(const struct pending_callback *pending, size_t count, enum handle_kind kind)
+{
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t i = 0; i < count; i++) {
+		if (handle_get(pending[i].id, kind)) {
+			handle_free(pending[i].id);
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+}
+
+// libmoq API
+
+int32_t moq_log_level(const char *level, uintptr_t level_len)
+{
+	(void)level;
+	(void)level_len;
+	return 0;
+}
+
+int32_t moq_origin_create(void)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = handle_new(HANDLE_ORIGIN);
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+int32_t moq_origin_close(int32_t origin)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(origin, HANDLE_ORIGIN);
+	if (result == 0) {
+		origin_remove(origin, NULL);
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_origin_consume(int32_t origin, const char *path, uintptr_t path_len)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = -1;
+	if (handle_get(origin, HANDLE_ORIGIN) && origin_has(origin, path, path_len)) {
+		id = handle_new(HANDLE_CONSUME);
+		if (id > 0) {
+			struct handle *consume = handle_get(id, HANDLE_CONSUME);
+			consume->origin = origin;
+			consume->str = copy_string(path, path_len);
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+#ifdef HAVE_MOQ_ORIGIN_PUBLISH
+int32_t moq_origin_publish(int32_t origin, const char *path, uintptr_t path_len, int32_t broadcast)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = -1;
+	if (handle_get(origin, HANDLE_ORIGIN) && handle_get(broadcast, HANDLE_CONSUME) &&
+	    !origin_has(origin, path, path_len)) {
+		fake.announcements = realloc(fake.announcements,
+					     sizeof(*fake.announcements) * (fake.announcements_len + 1));
+		fake.announcements[fake.announcements_len++] =
+			(struct announcement){origin, copy_string(path, path_len), broadcast};
+		result = 0;
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+#endif
+
+int32_t moq_origin_announced(int32_t origin, void (*on_announce)(void *user_data, int32_t announced),
+			     void *user_data)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = -1;
+	if (handle_get(origin, HANDLE_ORIGIN)) {
+		id = handle_new(HANDLE_ANNOUNCED);
+		if (id > 0) {
+			struct handle *watcher = handle_get(id, HANDLE_ANNOUNCED);
+			watcher->origin = origin;
+			watcher->callback = on_announce;
+			watcher->user_data = user_data;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+int32_t moq_origin_announced_info(int32_t announced, struct Announced *info)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *handle = handle_get(announced, HANDLE_ANNOUNCED_INFO);
+	if (handle) {
+		info->path = handle->str;
+		info->path_len = strlen(handle->str);
+		info->active = handle->active;
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return handle ? 0 : -1;
+}
+
+int32_t moq_origin_announced_close(int32_t announced)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(announced, HANDLE_ANNOUNCED);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_session_connect(const char *url, uintptr_t url_len, int32_t publish_origin, int32_t consume_origin,
+			    void (*on_status)(void *user_data, int32_t code), void *user_data)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = -1;
+	if ((publish_origin == 0 || handle_get(publish_origin, HANDLE_ORIGIN)) &&
+	    (consume_origin == 0 || handle_get(consume_origin, HANDLE_ORIGIN))) {
+		id = handle_new(HANDLE_SESSION);
+		if (id > 0) {
+			struct handle *session = handle_get(id, HANDLE_SESSION);
+			session->str = copy_string(url, url_len);
+			session->origin = publish_origin;
+			session->origin2 = consume_origin;
+			session->callback = on_status;
+			session->user_data = user_data;
+			url_count_get(url, url_len)->connects++;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+int32_t moq_session_close(int32_t session)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *handle = handle_get(session, HANDLE_SESSION);
+	if (handle) {
+		url_count_get(handle->str, strlen(handle->str))->closes++;
+	}
+	int32_t result = handle_close(session, HANDLE_SESSION);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_consume_catalog(int32_t broadcast, void (*on_catalog)(void *user_data, int32_t catalog),
+			    void *user_data)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = -1;
+	if (handle_get(broadcast, HANDLE_CONSUME)) {
+		id = handle_new(HANDLE_CATALOG);
+		if (id > 0) {
+			struct handle *catalog = handle_get(id, HANDLE_CATALOG);
+			catalog->parent = broadcast;
+			catalog->callback = on_catalog;
+			catalog->user_data = user_data;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+int32_t moq_consume_catalog_close(int32_t catalog)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(catalog, HANDLE_CATALOG);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+#ifdef HAVE_MOQ_VIDEO_CONFIG
+int32_t moq_consume_video_config(int32_t catalog, uint32_t index, struct VideoConfig *config)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = -1;
+	struct handle *snapshot = handle_get(catalog, HANDLE_CATALOG_SNAPSHOT);
+	if (snapshot) {
+		struct broadcast *broadcast = broadcast_get(snapshot->str, strlen(snapshot->str));
+		if (index < broadcast->rendition_count) {
+			memset(config, 0, sizeof(*config));
+			config->codec = "avc1";
+			config->codec_len = 4;
+			config->coded_width = broadcast->renditions[index].width;
+			config->coded_height = broadcast->renditions[index].height;
+			config->bitrate = broadcast->renditions[index].bitrate;
+			result = 0;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+#endif
+
+#ifdef HAVE_MOQ_AUDIO_CONFIG
+int32_t moq_consume_audio_config(int32_t catalog, uint32_t index, struct AudioConfig *config)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = -1;
+	struct handle *snapshot = handle_get(catalog, HANDLE_CATALOG_SNAPSHOT);
+	if (snapshot && index == 0) {
+		struct broadcast *broadcast = broadcast_get(snapshot->str, strlen(snapshot->str));
+		if (broadcast->audio_codec) {
+			memset(config, 0, sizeof(*config));
+			config->codec = broadcast->audio_codec;
+			config->codec_len = strlen(broadcast->audio_codec);
+			config->sample_rate = broadcast->audio_sample_rate;
+			config->channel_count = broadcast->audio_channels;
+			result = 0;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+#endif
+
+static int32_t subscribe_track(enum handle_kind kind, int32_t broadcast, uint32_t index,
+			       void (*on_frame)(void *user_data, int32_t frame), void *user_data)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t id = -1;
+	if (handle_get(broadcast, HANDLE_CONSUME)) {
+		id = handle_new(kind);
+		if (id > 0) {
+			struct handle *track = handle_get(id, kind);
+			track->parent = broadcast;
+			track->index = index;
+			track->callback = on_frame;
+			track->user_data = user_data;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return id;
+}
+
+int32_t moq_consume_video_track(int32_t broadcast, uint32_t index, uint64_t max_latency_ms,
+				void (*on_frame)(void *user_data, int32_t frame), void *user_data)
+{
+	(void)max_latency_ms;
+	return subscribe_track(HANDLE_VIDEO_TRACK, broadcast, index, on_frame, user_data);
+}
+
+int32_t moq_consume_video_track_close(int32_t track)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(track, HANDLE_VIDEO_TRACK);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_consume_audio_track(int32_t broadcast, uint32_t index, uint64_t max_latency_ms,
+				void (*on_frame)(void *user_data, int32_t frame), void *user_data)
+{
+	(void)max_latency_ms;
+	return subscribe_track(HANDLE_AUDIO_TRACK, broadcast, index, on_frame, user_data);
+}
+
+int32_t moq_consume_audio_track_close(int32_t track)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(track, HANDLE_AUDIO_TRACK);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_consume_frame_chunk(int32_t frame, uint32_t index, struct Frame *chunk)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *handle = handle_get(frame, HANDLE_FRAME);
+	if (handle && index == 0) {
+		*chunk = handle->frame;
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return handle && index == 0 ? 0 : -1;
+}
+
+int32_t moq_consume_frame_close(int32_t frame)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(frame, HANDLE_FRAME);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+int32_t moq_consume_close(int32_t broadcast)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t result = handle_close(broadcast, HANDLE_CONSUME);
+	pthread_mutex_unlock(&fake.mutex);
+	return result;
+}
+
+// Test driver
+
+void fake_moq_reset(void)
+{
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t slot = 0; slot < fake.used; slot++) {
+		free(fake.handles[slot].str);
+		free((void *)fake.handles[slot].frame.payload);
+	}
+	memset(fake.handles, 0, sizeof(fake.handles));
+	fake.free_len = 0;
+	fake.used = 0;
+
+	for (size_t i = 0; i < fake.announcements_len; i++) {
+		free(fake.announcements[i].path);
+	}
+	free(fake.announcements);
+	fake.announcements = NULL;
+	fake.announcements_len = 0;
+
+	for (size_t i = 0; i < fake.broadcasts_len; i++) {
+		free(fake.broadcasts[i].path);
+		free(fake.broadcasts[i].audio_codec);
+	}
+	free(fake.broadcasts);
+	fake.broadcasts = NULL;
+	fake.broadcasts_len = 0;
+
+	for (size_t i = 0; i < fake.urls_len; i++) {
+		free(fake.urls[i].url);
+	}
+	free(fake.urls);
+	fake.urls = NULL;
+	fake.urls_len = 0;
+
+	fake.bad_closes = 0;
+	pthread_mutex_unlock(&fake.mutex);
+}
+
+int32_t fake_moq_session(const char *url)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t found = 0;
+	for (size_t slot = 0; slot < fake.used; slot++) {
+		struct handle *handle = &fake.handles[slot];
+		if (handle->kind == HANDLE_SESSION && strcmp(handle->str, url) == 0) {
+			found = (int32_t)(((uint32_t)handle->gen << HANDLE_GEN_SHIFT) | (slot + 1));
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return found;
+}
+
+int32_t fake_moq_session_publish_origin(int32_t session_id)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *session = handle_get(session_id, HANDLE_SESSION);
+	int32_t origin = session ? session->origin : 0;
+	pthread_mutex_unlock(&fake.mutex);
+	return origin;
+}
+
+int32_t fake_moq_session_consume_origin(int32_t session_id)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *session = handle_get(session_id, HANDLE_SESSION);
+	int32_t origin = session ? session->origin2 : 0;
+	pthread_mutex_unlock(&fake.mutex);
+	return origin;
+}
+
+size_t fake_moq_connect_count(const char *url)
+{
+	pthread_mutex_lock(&fake.mutex);
+	size_t count = url_count_get(url, strlen(url))->connects;
+	pthread_mutex_unlock(&fake.mutex);
+	return count;
+}
+
+size_t fake_moq_close_count(const char *url)
+{
+	pthread_mutex_lock(&fake.mutex);
+	size_t count = url_count_get(url, strlen(url))->closes;
+	pthread_mutex_unlock(&fake.mutex);
+	return count;
+}
+
+void fake_moq_session_status(int32_t session_id, int32_t code)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct handle *session = handle_get(session_id, HANDLE_SESSION);
+	struct pending_callback pending = {0};
+	if (session) {
+		pending.callback = session->callback;
+		pending.user_data = session->user_data;
+		pending.id = code;
+	}
+	pthread_mutex_unlock(&fake.mutex);
+
+	if (pending.callback) {
+		run_callbacks(&pending, 1);
+	}
+}
+
+void fake_moq_drop_sessions(const char *url, int32_t code)
+{
+	struct pending_callback pending[MAX_CALLBACKS];
+	size_t count = 0;
+
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t slot = 0; slot < fake.used && count < MAX_CALLBACKS; slot++) {
+		struct handle *handle = &fake.handles[slot];
+		if (handle->kind == HANDLE_SESSION && strcmp(handle->str, url) == 0 && handle->callback) {
+			pending[count++] = (struct pending_callback){handle->callback, handle->user_data, code};
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+
+	run_callbacks(pending, count);
+}
+
+void fake_moq_announce(const char *url, const char *path, bool active)
+{
+	struct pending_callback pending[MAX_CALLBACKS];
+	size_t count = 0;
+	size_t path_len = strlen(path);
+
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t slot = 0; slot < fake.used; slot++) {
+		struct handle *session = &fake.handles[slot];
+		if (session->kind != HANDLE_SESSION || strcmp(session->str, url) != 0 || session->origin2 == 0) {
+			continue;
+		}
+
+		int32_t origin = session->origin2;
+		if (origin_has(origin, path, path_len) == active) {
+			continue;
+		}
+		if (active) {
+			fake.announcements = realloc(fake.announcements,
+						     sizeof(*fake.announcements) * (fake.announcements_len + 1));
+			fake.announcements[fake.announcements_len++] =
+				(struct announcement){origin, copy_string(path, path_len), 0};
+		} else {
+			origin_remove(origin, path);
+		}
+
+		for (size_t watcher_slot = 0; watcher_slot < fake.used && count < MAX_CALLBACKS; watcher_slot++) {
+			struct handle *watcher = &fake.handles[watcher_slot];
+			if (watcher->kind != HANDLE_ANNOUNCED || watcher->origin != origin) {
+				continue;
+			}
+			int32_t info_id = handle_new(HANDLE_ANNOUNCED_INFO);
+			if (info_id <= 0) {
+				break;
+			}
+			struct handle *info = handle_get(info_id, HANDLE_ANNOUNCED_INFO);
+			info->str = copy_string(path, path_len);
+			info->active = active;
+			pending[count++] = (struct pending_callback){watcher->callback, watcher->user_data, info_id};
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+
+	run_callbacks(pending, count);
+	free_borrowed(pending, count, HANDLE_ANNOUNCED_INFO);
+}
+
+bool fake_moq_published(const char *url, const char *path)
+{
+	pthread_mutex_lock(&fake.mutex);
+	bool published = false;
+	for (size_t slot = 0; slot < fake.used && !published; slot++) {
+		struct handle *session = &fake.handles[slot];
+		if (session->kind == HANDLE_SESSION && strcmp(session->str, url) == 0 && session->origin != 0) {
+			published = handle_get(session->origin, HANDLE_ORIGIN) &&
+				    origin_has_live(session->origin, path, strlen(path));
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return published;
+}
+
+void fake_moq_set_renditions(const char *path, const struct fake_moq_rendition *renditions, size_t count)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct broadcast *broadcast = broadcast_get(path, strlen(path));
+	broadcast->rendition_count = count < MAX_RENDITIONS ? count : MAX_RENDITIONS;
+	memcpy(broadcast->renditions, renditions, sizeof(*renditions) * broadcast->rendition_count);
+	pthread_mutex_unlock(&fake.mutex);
+}
+
+void fake_moq_set_audio(const char *path, const char *codec, uint32_t sample_rate, uint32_t channels)
+{
+	pthread_mutex_lock(&fake.mutex);
+	struct broadcast *broadcast = broadcast_get(path, strlen(path));
+	free(broadcast->audio_codec);
+	broadcast->audio_codec = codec ? copy_string(codec, strlen(codec)) : NULL;
+	broadcast->audio_sample_rate = sample_rate;
+	broadcast->audio_channels = channels;
+	pthread_mutex_unlock(&fake.mutex);
+}
+
+size_t fake_moq_catalog_update(const char *path)
+{
+	struct pending_callback pending[MAX_CALLBACKS];
+	size_t count = 0;
+
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t slot = 0; slot < fake.used && count < MAX_CALLBACKS; slot++) {
+		struct handle *catalog = &fake.handles[slot];
+		if (catalog->kind != HANDLE_CATALOG) {
+			continue;
+		}
+		struct handle *consume = handle_get(catalog->parent, HANDLE_CONSUME);
+		if (!consume_live(consume) || strcmp(consume->str, path) != 0) {
+			continue;
+		}
+
+		int32_t snapshot_id = handle_new(HANDLE_CATALOG_SNAPSHOT);
+		if (snapshot_id <= 0) {
+			break;
+		}
+		handle_get(snapshot_id, HANDLE_CATALOG_SNAPSHOT)->str = copy_string(path, strlen(path));
+		pending[count++] = (struct pending_callback){catalog->callback, catalog->user_data, snapshot_id};
+	}
+	pthread_mutex_unlock(&fake.mutex);
+
+	run_callbacks(pending, count);
+	free_borrowed(pending, count, HANDLE_CATALOG_SNAPSHOT);
+	return count;
+}
+
+static size_t push_frame(enum handle_kind kind, const char *path, uint32_t index, uint64_t timestamp_us,
+			 bool keyframe, const void *payload, size_t size)
+{
+	struct pending_callback pending[MAX_CALLBACKS];
+	size_t count = 0;
+
+	pthread_mutex_lock(&fake.mutex);
+	for (size_t slot = 0; slot < fake.used && count < MAX_CALLBACKS; slot++) {
+		struct handle *track = &fake.handles[slot];
+		if (track->kind != kind || track->index != index) {
+			continue;
+		}
+		struct handle *consume = handle_get(track->parent, HANDLE_CONSUME);
+		if (!consume_live(consume) || strcmp(consume->str, path) != 0) {
+			continue;
+		}
+
+		int32_t frame_id = handle_new(HANDLE_FRAME);
+		if (frame_id <= 0) {
+			break;
+		}
+		struct handle *frame = handle_get(frame_id, HANDLE_FRAME);
+		uint8_t *copy = malloc(size ? size : 1);
+		memcpy(copy, payload, size);
+		frame->frame.payload = copy;
+		frame->frame.payload_size = size;
+		frame->frame.timestamp_us = timestamp_us;
+		frame->frame.keyframe = keyframe;
+		pending[count++] = (struct pending_callback){track->callback, track->user_data, frame_id};
+	}
+	pthread_mutex_unlock(&fake.mutex);
+
+	run_callbacks(pending, count);
+	return count;
+}
+
+size_t fake_moq_push_video(const char *path, uint32_t index, uint64_t timestamp_us, bool keyframe,
+			   const void *payload, size_t size)
+{
+	return push_frame(HANDLE_VIDEO_TRACK, path, index, timestamp_us, keyframe, payload, size);
+}
+
+size_t fake_moq_push_audio(const char *path, uint64_t timestamp_us, const void *payload, size_t size)
+{
+	return push_frame(HANDLE_AUDIO_TRACK, path, 0, timestamp_us, true, payload, size);
+}
+
+int32_t fake_moq_video_index(const char *path)
+{
+	pthread_mutex_lock(&fake.mutex);
+	int32_t index = -1;
+	for (size_t slot = 0; slot < fake.used; slot++) {
+		struct handle *track = &fake.handles[slot];
+		if (track->kind != HANDLE_VIDEO_TRACK) {
+			continue;
+		}
+		struct handle *consume = handle_get(track->parent, HANDLE_CONSUME);
+		if (consume && strcmp(consume->str, path) == 0) {
+			index = (int32_t)track->index;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return index;
+}
+
+size_t fake_moq_open_handles(void)
+{
+	pthread_mutex_lock(&fake.mutex);
+	size_t count = 0;
+	for (size_t slot = 0; slot < fake.used; slot++) {
+		enum handle_kind kind = fake.handles[slot].kind;
+		if (kind != HANDLE_FREE && kind != HANDLE_ANNOUNCED_INFO && kind != HANDLE_CATALOG_SNAPSHOT) {
+			count++;
+		}
+	}
+	pthread_mutex_unlock(&fake.mutex);
+	return count;
+}
+
+size_t fake_moq_bad_closes(void)
+{
+	pthread_mutex_lock(&fake.mutex);
+	size_t count = fake.bad_closes;
+	pthread_mutex_unlock(&fake.mutex);
+	return count;
+}
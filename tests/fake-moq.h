@@ -0,0 +1,76 @@
+/*
+In-Process MoQ Stand-In for Hang Source Tests
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Implements the moq.h API against in-memory relays, so tests link this instead of libmoq.
+// Nothing happens on its own: the test plays the relay and publisher through the functions
+// below, and callbacks run on the calling thread before they return.
+
+// A video track as the publisher's catalog lists it
+struct fake_moq_rendition {
+	uint32_t width;
+	uint32_t height;
+	uint64_t bitrate; // bits per second, 0 if the catalog has none
+};
+
+// Forget every handle, relay and broadcast
+void fake_moq_reset(void);
+
+// Newest open session connected to a relay url, or 0
+int32_t fake_moq_session(const char *url);
+int32_t fake_moq_session_publish_origin(int32_t session_id);
+int32_t fake_moq_session_consume_origin(int32_t session_id);
+// Sessions ever connected to and closed for a relay url
+size_t fake_moq_connect_count(const char *url);
+size_t fake_moq_close_count(const char *url);
+// Report connection status to a session's callback (0 connected, negative error)
+void fake_moq_session_status(int32_t session_id, int32_t code);
+// Fail every open session to a relay url with this code, as a dropped connection would
+void fake_moq_drop_sessions(const char *url, int32_t code);
+
+// The publisher on a relay starts or stops a broadcast. Open sessions consuming from
+// that relay see the announcement in their origin.
+void fake_moq_announce(const char *url, const char *path, bool active);
+// Whether a broadcast reaches subscribers of a relay through a session publishing to it
+bool fake_moq_published(const char *url, const char *path);
+
+// Catalog contents for a broadcast, and a catalog update to everyone subscribed to it.
+// Renditions are only visible to the source when libmoq has moq_consume_video_config.
+void fake_moq_set_renditions(const char *path, const struct fake_moq_rendition *renditions, size_t count);
+// The first audio track's WebCodecs codec string (NULL for none), visible to the source
+// only when libmoq has moq_consume_audio_config
+void fake_moq_set_audio(const char *path, const char *codec, uint32_t sample_rate, uint32_t channels);
+size_t fake_moq_catalog_update(const char *path);
+
+// Deliver a frame to every open track subscription of a broadcast; returns the
+// number of subscriptions that received it
+size_t fake_moq_push_video(const char *path, uint32_t index, uint64_t timestamp_us, bool keyframe,
+			   const void *payload, size_t size);
+size_t fake_moq_push_audio(const char *path, uint64_t timestamp_us, const void *payload, size_t size);
+
+// Video track index subscribed for a broadcast, or -1 if none
+int32_t fake_moq_video_index(const char *path);
+
+// Handles the plugin still holds, and closes of handles that were not open
+size_t fake_moq_open_handles(void);
+size_t fake_moq_bad_closes(void);
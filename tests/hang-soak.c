@@ -0,0 +1,801 @@
+/*
+Soak Harness for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Runs many hang sources for hours against the in-process MoQ stand-in, playing a live
+// publisher in real time: 1080p video and audio frames, periodic catalog updates, publisher
+// restarts and relay reconnects. Every source is on program and ticked like the OBS video
+// thread would, so audio is decoded and frames are paced and converted. Samples memory,
+// heap fragmentation, presentation latency and drop counters along the way and fails if
+// they trend upwards. --skew runs the publisher's clock fast (or slow, if negative) by the
+// given parts per million, as a real encoder's clock drifts against ours.
+//
+//   hang-soak [--sources N] [--seconds S] [--sample S] [--reconnect S] [--catalog S]
+//             [--restart S] [--skew PPM] [--output samples.csv]
+
+#include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+
+#include "hang-source.h"
+#include "fake-moq.h"
+#include "test-support.h"
+
+#define RELAY_A_URL "https://relay-a.soak.test/"
+#define RELAY_B_URL "https://relay-b.soak.test/"
+
+#define VIDEO_INTERVAL_US 33333
+#define AUDIO_INTERVAL_US 20000
+#define CLIP_WIDTH 1920
+#define CLIP_HEIGHT 1080
+#define CLIP_FRAMES 60
+#define CLIP_GOP 30
+
+// One second of 48 kHz stereo audio, 20 ms per packet
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_PACKET_SAMPLES 960
+#define AUDIO_CLIP_PACKETS 50
+
+// A 60 fps canvas
+#define TICK_INTERVAL_US 16667
+
+// Publisher timestamps start far from zero, as a real encoder's wall clock does
+#define PUBLISHER_EPOCH_US 1000000000000ULL
+
+// Samples taken before this are ignored for trends (connection setup, caches warming up)
+#define WARMUP_SAMPLES 5
+// Trends need this many samples before they are judged
+#define MIN_TREND_SAMPLES 10
+
+// Growth per hour that is flagged as a leak or drift
+#define RSS_TREND_LIMIT_MB 16.0
+#define ALLOCS_TREND_LIMIT 2000.0
+#define LATENCY_TREND_LIMIT_MS 50.0
+
+struct soak_options {
+	unsigned int sources;
+	unsigned int seconds;
+	unsigned int sample_seconds;
+	unsigned int reconnect_seconds;
+	unsigned int catalog_seconds;
+	unsigned int restart_seconds;
+	int skew_ppm;
+	const char *output;
+};
+
+// One encoded access unit of the looping test clip, length-prefixed as MoQ carries it
+struct clip_frame {
+	uint8_t *data;
+	size_t size;
+	bool keyframe;
+};
+
+struct soak_source {
+	obs_source_t *source;
+	struct hang_source *context;
+	char path[32];
+	bool on_relay_b;
+
+	// Presentation latency since the last sample: how long after the publisher sent it the
+	// newest frame was shown, or the newest audio handed to OBS
+	uint64_t last_frame_id;
+	double video_latency_max_ms;
+	double audio_latency_max_ms;
+};
+
+// Least-squares slope over all samples, kept as running sums so hours of samples cost nothing
+struct trend {
+	double n;
+	double sum_t;
+	double sum_tt;
+	double sum_y;
+	double sum_ty;
+};
+
+static struct clip_frame clip[CLIP_FRAMES];
+static size_t clip_len;
+static struct clip_frame audio_clip[AUDIO_CLIP_PACKETS];
+static size_t audio_clip_len;
+static const char *audio_codec;
+static double publisher_rate;
+
+static struct trend rss_trend;
+static struct trend allocs_trend;
+static struct trend latency_trend;
+static unsigned int samples;
+static long reconnects;
+
+static void trend_add(struct trend *trend, double t, double y)
+{
+	trend->n += 1.0;
+	trend->sum_t += t;
+	trend->sum_tt += t * t;
+	trend->sum_y += y;
+	trend->sum_ty += t * y;
+}
+
+static double trend_slope(const struct trend *trend)
+{
+	double denom = trend->n * trend->sum_tt - trend->sum_t * trend->sum_t;
+	if (denom <= 0.0) {
+		return 0.0;
+	}
+	return (trend->n * trend->sum_ty - trend->sum_t * trend->sum_y) / denom;
+}
+
+static bool parse_options(int argc, char **argv, struct soak_options *options)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *name = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		unsigned int *number = NULL;
+
+		if (strcmp(name, "--output") == 0 && value) {
+			options->output = value;
+			i++;
+			continue;
+		} else if (strcmp(name, "--skew") == 0 && value) {
+			options->skew_ppm = (int)strtol(value, NULL, 10);
+			i++;
+			continue;
+		} else if (strcmp(name, "--sources") == 0) {
+			number = &options->sources;
+		} else if (strcmp(name, "--seconds") == 0) {
+			number = &options->seconds;
+		} else if (strcmp(name, "--sample") == 0) {
+			number = &options->sample_seconds;
+		} else if (strcmp(name, "--reconnect") == 0) {
+			number = &options->reconnect_seconds;
+		} else if (strcmp(name, "--catalog") == 0) {
+			number = &options->catalog_seconds;
+		} else if (strcmp(name, "--restart") == 0) {
+			number = &options->restart_seconds;
+		}
+
+		if (!number || !value) {
+			fprintf(stderr, "Unknown or incomplete option: %s\n", name);
+			return false;
+		}
+		*number = (unsigned int)strtoul(value, NULL, 10);
+		i++;
+	}
+
+	return options->sources > 0 && options->sample_seconds > 0;
+}
+
+// Find the next Annex B start code at or after pos; returns its offset and length
+static size_t find_start_code(const uint8_t *data, size_t size, size_t pos, size_t *code_len)
+{
+	for (; pos + 3 <= size; pos++) {
+		if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) {
+			*code_len = 3;
+			return pos;
+		}
+		if (pos + 4 <= size && data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 0 &&
+		    data[pos + 3] == 1) {
+			*code_len = 4;
+			return pos;
+		}
+	}
+	*code_len = 0;
+	return size;
+}
+
+// Encoders emit Annex B; the source expects 4-byte NAL lengths
+static void append_clip_frame(const AVPacket *packet)
+{
+	if (clip_len == CLIP_FRAMES) {
+		return;
+	}
+
+	struct clip_frame *frame = &clip[clip_len++];
+	frame->data = bmalloc((size_t)packet->size + 64);
+	frame->size = 0;
+	frame->keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+	size_t code_len;
+	size_t start = find_start_code(packet->data, packet->size, 0, &code_len);
+	while (start < (size_t)packet->size) {
+		size_t nal = start + code_len;
+		size_t next_len;
+		size_t next = find_start_code(packet->data, packet->size, nal, &next_len);
+		size_t nal_size = next - nal;
+
+		frame->data = brealloc(frame->data, frame->size + 4 + nal_size);
+		frame->data[frame->size++] = (uint8_t)(nal_size >> 24);
+		frame->data[frame->size++] = (uint8_t)(nal_size >> 16);
+		frame->data[frame->size++] = (uint8_t)(nal_size >> 8);
+		frame->data[frame->size++] = (uint8_t)nal_size;
+		memcpy(frame->data + frame->size, packet->data + nal, nal_size);
+		frame->size += nal_size;
+
+		start = next;
+		code_len = next_len;
+	}
+}
+
+// Encode a short moving gradient with whatever H.264 encoder FFmpeg has, so frames exercise
+// the real decode path
+static bool encode_clip(void)
+{
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+	if (!codec) {
+		return false;
+	}
+
+	AVCodecContext *encoder = avcodec_alloc_context3(codec);
+	AVFrame *picture = av_frame_alloc();
+	AVPacket *packet = av_packet_alloc();
+	bool ok = false;
+
+	if (!encoder || !picture || !packet) {
+		goto done;
+	}
+
+	encoder->width = CLIP_WIDTH;
+	encoder->height = CLIP_HEIGHT;
+	encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+	encoder->time_base = (AVRational){1, 30};
+	encoder->framerate = (AVRational){30, 1};
+	encoder->gop_size = CLIP_GOP;
+	encoder->max_b_frames = 0;
+	if (avcodec_open2(encoder, codec, NULL) < 0) {
+		goto done;
+	}
+
+	picture->format = encoder->pix_fmt;
+	picture->width = encoder->width;
+	picture->height = encoder->height;
+	if (av_frame_get_buffer(picture, 0) < 0) {
+		goto done;
+	}
+
+	for (int i = 0; i <= CLIP_FRAMES; i++) {
+		AVFrame *input = NULL;
+		if (i < CLIP_FRAMES) {
+			av_frame_make_writable(picture);
+			for (int y = 0; y < picture->height; y++) {
+				for (int x = 0; x < picture->width; x++) {
+					picture->data[0][y * picture->linesize[0] + x] = (uint8_t)(x + y + i * 3);
+				}
+			}
+			for (int y = 0; y < picture->height / 2; y++) {
+				memset(picture->data[1] + y * picture->linesize[1], 128, picture->width / 2);
+				memset(picture->data[2] + y * picture->linesize[2], 128, picture->width / 2);
+			}
+			picture->pts = i;
+			input = picture;
+		}
+
+		// A NULL frame drains the encoder after the last picture
+		if (avcodec_send_frame(encoder, input) < 0) {
+			goto done;
+		}
+		while (avcodec_receive_packet(encoder, packet) == 0) {
+			append_clip_frame(packet);
+			av_packet_unref(packet);
+		}
+	}
+
+	ok = clip_len > 0;
+
+done:
+	av_packet_free(&packet);
+	av_frame_free(&picture);
+	avcodec_free_context(&encoder);
+	return ok;
+}
+
+// Without an encoder, frames still flow through delivery, the congestion policy and the
+// decoder's error handling
+static void filler_clip(void)
+{
+	for (size_t i = 0; i < CLIP_FRAMES; i++) {
+		struct clip_frame *frame = &clip[clip_len++];
+		frame->size = 1024;
+		frame->data = bzalloc(frame->size);
+		frame->keyframe = i % CLIP_GOP == 0;
+		size_t nal_size = frame->size - 4;
+		frame->data[2] = (uint8_t)(nal_size >> 8);
+		frame->data[3] = (uint8_t)nal_size;
+		frame->data[4] = frame->keyframe ? 0x65 : 0x41;
+	}
+}
+
+// A 375 Hz triangle wave that runs on across packets, so the one second clip loops cleanly
+static void fill_tone(int16_t *samples, size_t packet)
+{
+	for (size_t n = 0; n < AUDIO_PACKET_SAMPLES; n++) {
+		size_t phase = (packet * AUDIO_PACKET_SAMPLES + n) % 128;
+		int16_t value = (int16_t)((phase < 64 ? phase : 128 - phase) * 256 - 8192);
+		for (size_t ch = 0; ch < AUDIO_CHANNELS; ch++) {
+			samples[n * AUDIO_CHANNELS + ch] = value;
+		}
+	}
+}
+
+static void append_audio_packet(const uint8_t *data, size_t size)
+{
+	if (audio_clip_len == AUDIO_CLIP_PACKETS) {
+		return;
+	}
+
+	struct clip_frame *packet = &audio_clip[audio_clip_len++];
+	packet->data = bmalloc(size);
+	packet->size = size;
+	memcpy(packet->data, data, size);
+}
+
+// Opus is what hang publishers send; encode the tone with libopus when FFmpeg has it
+static bool encode_audio_clip(void)
+{
+	const AVCodec *codec = avcodec_find_encoder_by_name("libopus");
+	if (!codec) {
+		return false;
+	}
+
+	AVCodecContext *encoder = avcodec_alloc_context3(codec);
+	AVFrame *samples = av_frame_alloc();
+	AVPacket *packet = av_packet_alloc();
+	bool ok = false;
+
+	if (!encoder || !samples || !packet) {
+		goto done;
+	}
+
+	encoder->sample_rate = AUDIO_SAMPLE_RATE;
+	encoder->sample_fmt = AV_SAMPLE_FMT_S16;
+	encoder->bit_rate = 96000;
+	encoder->time_base = (AVRational){1, AUDIO_SAMPLE_RATE};
+	av_channel_layout_default(&encoder->ch_layout, AUDIO_CHANNELS);
+	if (avcodec_open2(encoder, codec, NULL) < 0 || encoder->frame_size != AUDIO_PACKET_SAMPLES) {
+		goto done;
+	}
+
+	samples->format = encoder->sample_fmt;
+	samples->sample_rate = encoder->sample_rate;
+	samples->nb_samples = AUDIO_PACKET_SAMPLES;
+	if (av_channel_layout_copy(&samples->ch_layout, &encoder->ch_layout) < 0 ||
+	    av_frame_get_buffer(samples, 0) < 0) {
+		goto done;
+	}
+
+	for (int i = 0; i <= AUDIO_CLIP_PACKETS; i++) {
+		AVFrame *input = NULL;
+		if (i < AUDIO_CLIP_PACKETS) {
+			av_frame_make_writable(samples);
+			fill_tone((int16_t *)samples->data[0], (size_t)i);
+			samples->pts = (int64_t)i * AUDIO_PACKET_SAMPLES;
+			input = samples;
+		}
+
+		// A NULL frame drains the encoder after the last packet
+		if (avcodec_send_frame(encoder, input) < 0) {
+			goto done;
+		}
+		while (avcodec_receive_packet(encoder, packet) == 0) {
+			append_audio_packet(packet->data, (size_t)packet->size);
+			av_packet_unref(packet);
+		}
+	}
+
+	ok = audio_clip_len > 0;
+	audio_codec = "opus";
+
+done:
+	av_packet_free(&packet);
+	av_frame_free(&samples);
+	avcodec_free_context(&encoder);
+	return ok;
+}
+
+// Without an Opus encoder, send the tone as PCM and say so in the catalog
+static void pcm_audio_clip(void)
+{
+	int16_t samples[AUDIO_PACKET_SAMPLES * AUDIO_CHANNELS];
+	for (size_t i = 0; i < AUDIO_CLIP_PACKETS; i++) {
+		fill_tone(samples, i);
+		append_audio_packet((const uint8_t *)samples, sizeof(samples));
+	}
+	audio_codec = "pcm-s16";
+}
+
+static void free_clip_frames(struct clip_frame *frames, size_t *len)
+{
+	for (size_t i = 0; i < *len; i++) {
+		bfree(frames[i].data);
+	}
+	*len = 0;
+}
+
+static void free_clip(void)
+{
+	free_clip_frames(clip, &clip_len);
+	free_clip_frames(audio_clip, &audio_clip_len);
+}
+
+// The publisher's clock at our time t, running fast or slow by the configured skew
+static uint64_t publisher_time_us(uint64_t t_us)
+{
+	return PUBLISHER_EPOCH_US + (uint64_t)((double)t_us * publisher_rate);
+}
+
+// When, on our clock, the publisher sent media stamped with this timestamp
+static double sent_at_us(uint64_t timestamp_us)
+{
+	return (double)(int64_t)(timestamp_us - PUBLISHER_EPOCH_US) / publisher_rate;
+}
+
+static const char *relay_url(const struct soak_source *soak)
+{
+	return soak->on_relay_b ? RELAY_B_URL : RELAY_A_URL;
+}
+
+// Complete the source's newest session and show it the live broadcast and its catalog,
+// which a publisher sends to every new subscriber
+static void connect_source(struct soak_source *soak)
+{
+	int32_t session = fake_moq_session(relay_url(soak));
+	if (session > 0) {
+		fake_moq_session_status(session, 0);
+	}
+	fake_moq_announce(relay_url(soak), soak->path, true);
+	fake_moq_catalog_update(soak->path);
+}
+
+// Move every source to the other relay, which tears down and reopens the session,
+// announcements, catalog, tracks and decoders the same way a settings change does
+static void reconnect_sources(struct soak_source *sources, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		struct soak_source *soak = &sources[i];
+		soak->on_relay_b = !soak->on_relay_b;
+
+		obs_data_t *settings = obs_data_create();
+		obs_data_set_string(settings, "url", relay_url(soak));
+		test_update_source(soak->source, settings);
+		obs_data_release(settings);
+
+		connect_source(soak);
+		reconnects++;
+	}
+}
+
+// The publisher stops and starts again, which closes and reopens catalog and tracks
+static void restart_publishers(struct soak_source *sources, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		fake_moq_announce(relay_url(&sources[i]), sources[i].path, false);
+		fake_moq_announce(relay_url(&sources[i]), sources[i].path, true);
+		fake_moq_catalog_update(sources[i].path);
+	}
+}
+
+// Stand in for the OBS video thread: renders ask for one output size per source (full,
+// half or quarter, as scene, preview and multiview tiles would), then the tick presents
+// the frame that is due and hands queued audio to OBS. Latency is measured from when the
+// publisher sent what was just presented.
+static void tick_sources(struct soak_source *sources, unsigned int count, uint64_t start_ns)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		struct soak_source *soak = &sources[i];
+		struct hang_source *context = soak->context;
+
+		pthread_mutex_lock(&context->frame_mutex);
+		context->wanted_levels |= 1u << (i % FRAME_OUTPUT_LEVELS);
+		pthread_mutex_unlock(&context->frame_mutex);
+
+		// The newest decoded audio goes out on this tick
+		bool audio_queued = false;
+		uint64_t audio_timestamp_us = 0;
+		pthread_mutex_lock(&context->audio_mutex);
+		if (context->audio_queue_len > 0) {
+			audio_queued = true;
+			audio_timestamp_us = context->audio_queue[context->audio_queue_len - 1]->timestamp / 1000;
+		}
+		pthread_mutex_unlock(&context->audio_mutex);
+
+		hang_source_info.video_tick(context, (float)TICK_INTERVAL_US / 1e6f);
+
+		pthread_mutex_lock(&context->frame_mutex);
+		uint64_t frame_id = context->current_frame_id;
+		uint64_t frame_timestamp_us = context->current_frame_timestamp_us;
+		pthread_mutex_unlock(&context->frame_mutex);
+
+		double now_us = (double)(os_gettime_ns() - start_ns) / 1000.0;
+		if (frame_id != soak->last_frame_id && frame_timestamp_us > 0) {
+			double latency_ms = (now_us - sent_at_us(frame_timestamp_us)) / 1000.0;
+			if (latency_ms > soak->video_latency_max_ms) {
+				soak->video_latency_max_ms = latency_ms;
+			}
+		}
+		soak->last_frame_id = frame_id;
+
+		if (audio_queued) {
+			double latency_ms = (now_us - sent_at_us(audio_timestamp_us)) / 1000.0;
+			if (latency_ms > soak->audio_latency_max_ms) {
+				soak->audio_latency_max_ms = latency_ms;
+			}
+		}
+	}
+}
+
+static void take_sample(struct soak_source *sources, unsigned int count, uint64_t start_ns, FILE *output)
+{
+	double hours = (double)(os_gettime_ns() - start_ns) / 3600e9;
+	double rss_mb = (double)os_get_proc_resident_size() / (1024.0 * 1024.0);
+	long allocs = bnum_allocs();
+
+	// Heap fragmentation: share of the heap that is mapped but not in use
+	double fragmentation = 0.0;
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+	struct mallinfo2 info = mallinfo2();
+	if (info.arena > 0) {
+		fragmentation = 1.0 - (double)info.uordblks / (double)info.arena;
+	}
+#endif
+
+	long video_received = 0, video_decoded = 0, audio_received = 0, catalogs = 0;
+	double video_latency_max_ms = 0.0, audio_latency_max_ms = 0.0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct hang_source *context = sources[i].context;
+
+		video_received += os_atomic_load_long(&context->video_frames_received);
+		video_decoded += os_atomic_load_long(&context->video_frames_decoded);
+		audio_received += os_atomic_load_long(&context->audio_frames_received);
+		catalogs += os_atomic_load_long(&context->catalog_updates);
+
+		if (sources[i].video_latency_max_ms > video_latency_max_ms) {
+			video_latency_max_ms = sources[i].video_latency_max_ms;
+		}
+		if (sources[i].audio_latency_max_ms > audio_latency_max_ms) {
+			audio_latency_max_ms = sources[i].audio_latency_max_ms;
+		}
+		sources[i].video_latency_max_ms = 0.0;
+		sources[i].audio_latency_max_ms = 0.0;
+	}
+
+	long video_dropped = video_received - video_decoded;
+
+	printf("t=%.4fh rss=%.1fMB allocs=%ld frag=%.1f%% video_latency_max=%.1fms audio_latency_max=%.1fms "
+	       "video=%ld decoded=%ld dropped=%ld audio=%ld catalogs=%ld reconnects=%ld\n",
+	       hours, rss_mb, allocs, fragmentation * 100.0, video_latency_max_ms, audio_latency_max_ms,
+	       video_received, video_decoded, video_dropped, audio_received, catalogs, reconnects);
+	fflush(stdout);
+
+	if (output) {
+		fprintf(output, "%.4f,%u,%.1f,%ld,%.4f,%.1f,%.1f,%ld,%ld,%ld,%ld,%ld,%ld\n", hours, count, rss_mb,
+			allocs, fragmentation, video_latency_max_ms, audio_latency_max_ms, video_received,
+			video_decoded, video_dropped, audio_received, catalogs, reconnects);
+		fflush(output);
+	}
+
+	if (++samples <= WARMUP_SAMPLES) {
+		return;
+	}
+
+	trend_add(&rss_trend, hours, rss_mb);
+	trend_add(&allocs_trend, hours, (double)allocs);
+	trend_add(&latency_trend, hours,
+		  video_latency_max_ms > audio_latency_max_ms ? video_latency_max_ms : audio_latency_max_ms);
+}
+
+// Report growth trends; false if any of them points at a leak or drift
+static bool check_trends(void)
+{
+	if (rss_trend.n < MIN_TREND_SAMPLES) {
+		printf("Run too short for trends (%u samples)\n", samples);
+		return true;
+	}
+
+	double rss_slope = trend_slope(&rss_trend);
+	double allocs_slope = trend_slope(&allocs_trend);
+	double latency_slope = trend_slope(&latency_trend);
+	printf("Trends: rss %.1f MB/h, allocations %.0f/h, latency %.1f ms/h\n", rss_slope, allocs_slope,
+	       latency_slope);
+
+	bool ok = true;
+	if (rss_slope > RSS_TREND_LIMIT_MB) {
+		fprintf(stderr, "RSS growing %.1f MB/h\n", rss_slope);
+		ok = false;
+	}
+	if (allocs_slope > ALLOCS_TREND_LIMIT) {
+		fprintf(stderr, "Live allocations growing %.0f/h (possible leak)\n", allocs_slope);
+		ok = false;
+	}
+	if (latency_slope > LATENCY_TREND_LIMIT_MS) {
+		fprintf(stderr, "Latency drifting %.1f ms/h\n", latency_slope);
+		ok = false;
+	}
+	return ok;
+}
+
+static bool due(uint64_t now_us, uint64_t *last_us, unsigned int seconds)
+{
+	if (seconds == 0 || now_us - *last_us < (uint64_t)seconds * 1000000) {
+		return false;
+	}
+	*last_us = now_us;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	struct soak_options options = {
+		.sources = 8,
+		.seconds = 3600,
+		.sample_seconds = 60,
+		.reconnect_seconds = 900,
+		.catalog_seconds = 30,
+		.restart_seconds = 600,
+	};
+	if (!parse_options(argc, argv, &options)) {
+		fprintf(stderr, "usage: %s [--sources N] [--seconds S] [--sample S] [--reconnect S] "
+				"[--catalog S] [--restart S] [--skew PPM] [--output samples.csv]\n",
+			argv[0]);
+		return 2;
+	}
+
+	if (!test_startup()) {
+		return 1;
+	}
+
+	if (!encode_clip()) {
+		printf("No H.264 encoder available, sending filler video frames\n");
+		free_clip();
+		filler_clip();
+	}
+	if (!encode_audio_clip()) {
+		printf("No Opus encoder available, sending PCM audio\n");
+#ifndef HAVE_MOQ_AUDIO_CONFIG
+		printf("This libmoq cannot tell sources the audio codec, so the PCM will not decode\n");
+#endif
+		free_clip_frames(audio_clip, &audio_clip_len);
+		pcm_audio_clip();
+	}
+	publisher_rate = 1.0 + (double)options.skew_ppm / 1e6;
+
+	FILE *output = NULL;
+	if (options.output) {
+		output = os_fopen(options.output, "w");
+		if (!output) {
+			fprintf(stderr, "Failed to open %s\n", options.output);
+		} else {
+			fprintf(output, "hours,sources,rss_mb,allocs,fragmentation,video_latency_max_ms,"
+					"audio_latency_max_ms,video_frames,"
+					"video_decoded,video_dropped,audio_frames,catalogs,reconnects\n");
+		}
+	}
+
+	static const struct fake_moq_rendition renditions[] = {
+		{.width = CLIP_WIDTH, .height = CLIP_HEIGHT, .bitrate = 6000000},
+		{.width = CLIP_WIDTH, .height = CLIP_HEIGHT, .bitrate = 3000000},
+	};
+
+	struct soak_source *sources = bzalloc(sizeof(struct soak_source) * options.sources);
+	for (unsigned int i = 0; i < options.sources; i++) {
+		struct soak_source *soak = &sources[i];
+		snprintf(soak->path, sizeof(soak->path), "soak/%u", i);
+		fake_moq_set_renditions(soak->path, renditions, 2);
+		fake_moq_set_audio(soak->path, audio_codec, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS);
+
+		soak->source = test_create_source(RELAY_A_URL, soak->path, NULL);
+		soak->context = test_source_context(soak->source);
+		test_activate_source(soak->source);
+		connect_source(soak);
+	}
+
+	printf("Soaking %u sources for %us: sample %us, reconnect %us, catalog %us, publisher restart %us, "
+	       "skew %d ppm, %s audio\n",
+	       options.sources, options.seconds, options.sample_seconds, options.reconnect_seconds,
+	       options.catalog_seconds, options.restart_seconds, options.skew_ppm, audio_codec);
+
+	uint64_t start_ns = os_gettime_ns();
+	uint64_t end_us = (uint64_t)options.seconds * 1000000;
+	uint64_t next_video_us = 0, next_audio_us = 0, next_tick_us = 0;
+	uint64_t last_sample_us = 0, last_reconnect_us = 0, last_catalog_us = 0, last_restart_us = 0;
+	size_t clip_pos = 0, audio_clip_pos = 0;
+
+	// Everything is driven from this thread in real time, as a publisher and relay would
+	for (;;) {
+		uint64_t now_us = (os_gettime_ns() - start_ns) / 1000;
+		if (now_us >= end_us) {
+			break;
+		}
+
+		while (next_video_us <= now_us) {
+			const struct clip_frame *frame = &clip[clip_pos];
+			for (unsigned int i = 0; i < options.sources; i++) {
+				int32_t index = fake_moq_video_index(sources[i].path);
+				if (index >= 0) {
+					fake_moq_push_video(sources[i].path, (uint32_t)index,
+							    publisher_time_us(next_video_us), frame->keyframe,
+							    frame->data, frame->size);
+				}
+			}
+			clip_pos = (clip_pos + 1) % clip_len;
+			next_video_us += VIDEO_INTERVAL_US;
+		}
+		while (next_audio_us <= now_us) {
+			const struct clip_frame *packet = &audio_clip[audio_clip_pos];
+			for (unsigned int i = 0; i < options.sources; i++) {
+				fake_moq_push_audio(sources[i].path, publisher_time_us(next_audio_us), packet->data,
+						    packet->size);
+			}
+			audio_clip_pos = (audio_clip_pos + 1) % audio_clip_len;
+			next_audio_us += AUDIO_INTERVAL_US;
+		}
+
+		// One tick at the canvas rate; a late loop ticks once rather than catching up
+		if (next_tick_us <= now_us) {
+			tick_sources(sources, options.sources, start_ns);
+			next_tick_us = now_us + TICK_INTERVAL_US - (now_us - next_tick_us) % TICK_INTERVAL_US;
+		}
+
+		if (due(now_us, &last_catalog_us, options.catalog_seconds)) {
+			for (unsigned int i = 0; i < options.sources; i++) {
+				fake_moq_catalog_update(sources[i].path);
+			}
+		}
+		if (due(now_us, &last_restart_us, options.restart_seconds)) {
+			restart_publishers(sources, options.sources);
+		}
+		if (due(now_us, &last_reconnect_us, options.reconnect_seconds)) {
+			reconnect_sources(sources, options.sources);
+		}
+		if (due(now_us, &last_sample_us, options.sample_seconds)) {
+			take_sample(sources, options.sources, start_ns, output);
+		}
+
+		os_sleep_ms(5);
+	}
+
+	int result = check_trends() ? 0 : 1;
+
+	// Every reopen path must have closed what it opened
+	for (unsigned int i = 0; i < options.sources; i++) {
+		test_release_source(sources[i].source);
+	}
+	bfree(sources);
+	free_clip();
+
+	if (output) {
+		fclose(output);
+	}
+
+	if (fake_moq_open_handles() != 0 || fake_moq_bad_closes() != 0) {
+		fprintf(stderr, "MoQ handles left open: %zu, bad closes: %zu\n", fake_moq_open_handles(),
+			fake_moq_bad_closes());
+		result = 1;
+	}
+
+	return test_shutdown() ? 1 : result;
+}
@@ -0,0 +1,95 @@
+/*
+Announcement Lifecycle Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+
+#include "fake-moq.h"
+#include "test-support.h"
+
+#define UPSTREAM_URL "https://upstream.test/"
+#define BROADCAST "live/cam"
+#define OTHER_BROADCAST "live/other"
+#define LONGER_BROADCAST "live/cam2"
+
+static void set_broadcast(obs_source_t *source, const char *broadcast)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "url", UPSTREAM_URL);
+	obs_data_set_string(settings, "broadcast", broadcast);
+	test_update_source(source, settings);
+	obs_data_release(settings);
+}
+
+// Announce a broadcast and hand out its catalog, so a subscription picks a video track
+static bool announce(const char *path, bool active)
+{
+	fake_moq_announce(UPSTREAM_URL, path, active);
+	if (active) {
+		fake_moq_catalog_update(path);
+	}
+	return fake_moq_video_index(path) >= 0;
+}
+
+int main(void)
+{
+	if (!test_startup()) {
+		return 1;
+	}
+
+	obs_source_t *source = test_create_source(UPSTREAM_URL, BROADCAST, NULL);
+	TEST_CHECK(source != NULL);
+
+	int32_t upstream = fake_moq_session(UPSTREAM_URL);
+	TEST_CHECK(upstream > 0);
+	fake_moq_session_status(upstream, 0);
+
+	// Other broadcasts on the relay, including ones sharing a prefix, are ignored
+	TEST_CHECK(!announce(OTHER_BROADCAST, true));
+	TEST_CHECK(!announce(LONGER_BROADCAST, true));
+
+	// Announce, unannounce, re-announce: subscribed, dropped, subscribed again
+	TEST_CHECK(announce(BROADCAST, true));
+	size_t open_live = fake_moq_open_handles();
+
+	TEST_CHECK(!announce(BROADCAST, false));
+	TEST_CHECK(fake_moq_open_handles() < open_live);
+
+	TEST_CHECK(announce(BROADCAST, true));
+	TEST_CHECK(fake_moq_open_handles() == open_live);
+	TEST_CHECK(fake_moq_session(UPSTREAM_URL) == upstream);
+
+	// A second unannounce after the broadcast already went away changes nothing
+	TEST_CHECK(!announce(BROADCAST, false));
+	size_t open_idle = fake_moq_open_handles();
+	fake_moq_announce(UPSTREAM_URL, BROADCAST, false);
+	TEST_CHECK(fake_moq_open_handles() == open_idle);
+
+	// Switching the broadcast follows the new path and stops matching the old one
+	set_broadcast(source, OTHER_BROADCAST);
+	upstream = fake_moq_session(UPSTREAM_URL);
+	TEST_CHECK(upstream > 0);
+	fake_moq_session_status(upstream, 0);
+	TEST_CHECK(!announce(BROADCAST, true));
+	TEST_CHECK(announce(OTHER_BROADCAST, true));
+
+	test_release_source(source);
+	TEST_CHECK(fake_moq_open_handles() == 0);
+	TEST_CHECK(fake_moq_bad_closes() == 0);
+
+	return test_shutdown();
+}
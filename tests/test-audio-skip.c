@@ -0,0 +1,156 @@
+/*
+Audio Skip Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/threading.h>
+
+#include "hang-source.h"
+#include "audio-decoder.h"
+#include "fake-moq.h"
+#include "test-support.h"
+
+#define RELAY_URL "https://relay.test/"
+#define BROADCAST "live/mic"
+
+// 20 ms of 48 kHz stereo PCM per packet
+#define PACKET_US 20000
+#define PACKET_SAMPLES 960
+
+struct queued_audio {
+	size_t count;
+	uint64_t timestamp_ns;
+	uint32_t frames;
+	enum audio_format format;
+	enum speaker_layout speakers;
+	int16_t first_sample;
+};
+
+// Every sample of packet n is n, so decoded audio shows which packet it came from
+static size_t push_packet(uint32_t n)
+{
+	int16_t samples[PACKET_SAMPLES * 2];
+	for (size_t i = 0; i < PACKET_SAMPLES * 2; i++) {
+		samples[i] = (int16_t)n;
+	}
+	return fake_moq_push_audio(BROADCAST, (uint64_t)n * PACKET_US, samples, sizeof(samples));
+}
+
+// The newest decoded block waiting for the next video tick
+static struct queued_audio newest_audio(struct hang_source *context)
+{
+	struct queued_audio queued = {0};
+
+	pthread_mutex_lock(&context->audio_mutex);
+	queued.count = context->audio_queue_len;
+	if (queued.count > 0) {
+		const struct obs_source_audio *audio = context->audio_queue[queued.count - 1];
+		queued.timestamp_ns = audio->timestamp;
+		queued.frames = audio->frames;
+		queued.format = audio->format;
+		queued.speakers = audio->speakers;
+		queued.first_sample = ((const int16_t *)audio->data[0])[0];
+	}
+	pthread_mutex_unlock(&context->audio_mutex);
+
+	return queued;
+}
+
+int main(void)
+{
+	if (!test_startup()) {
+		return 1;
+	}
+
+	obs_source_t *source = test_create_source(RELAY_URL, BROADCAST, NULL);
+	struct hang_source *context = test_source_context(source);
+	TEST_CHECK(context != NULL);
+
+	// Plain PCM instead of Opus, so every packet decodes to exactly its own samples
+#ifdef HAVE_MOQ_AUDIO_CONFIG
+	fake_moq_set_audio(BROADCAST, "pcm-s16", 48000, 2);
+#else
+	pthread_mutex_lock(&context->decoder_mutex);
+	audio_decoder_destroy(context);
+	TEST_CHECK(audio_decoder_init_codec(context, "pcm_s16le", 48000, 2));
+	pthread_mutex_unlock(&context->decoder_mutex);
+#endif
+
+	fake_moq_session_status(fake_moq_session(RELAY_URL), 0);
+	fake_moq_announce(RELAY_URL, BROADCAST, true);
+	fake_moq_catalog_update(BROADCAST);
+
+	// Nobody hears a new source until it is on program or monitored
+	TEST_CHECK(push_packet(0) == 1);
+	TEST_CHECK(newest_audio(context).count == 0);
+
+	// On program: every packet is decoded, stamped with its own timestamp
+	test_activate_source(source);
+	for (uint32_t n = 1; n <= 3; n++) {
+		push_packet(n);
+	}
+	struct queued_audio heard = newest_audio(context);
+	TEST_CHECK(heard.count == 3);
+	TEST_CHECK(heard.timestamp_ns == 3ULL * PACKET_US * 1000);
+	TEST_CHECK(heard.frames == PACKET_SAMPLES);
+	TEST_CHECK(heard.format == AUDIO_FORMAT_16BIT);
+	TEST_CHECK(heard.speakers == SPEAKERS_STEREO);
+	TEST_CHECK(heard.first_sample == 3);
+
+	// Muted: packets are dropped undecoded
+	obs_source_set_muted(source, true);
+	for (uint32_t n = 4; n <= 8; n++) {
+		push_packet(n);
+	}
+	TEST_CHECK(newest_audio(context).count == 3);
+
+	// Unmuted: output resumes at the first packet after the skip, with its timestamp,
+	// and nothing from the skipped packets comes out
+	obs_source_set_muted(source, false);
+	push_packet(9);
+	struct queued_audio resumed = newest_audio(context);
+	TEST_CHECK(resumed.count == 4);
+	TEST_CHECK(resumed.timestamp_ns == 9ULL * PACKET_US * 1000);
+	TEST_CHECK(resumed.first_sample == 9);
+
+	push_packet(10);
+	TEST_CHECK(newest_audio(context).timestamp_ns == 10ULL * PACKET_US * 1000);
+
+#ifdef HAVE_MOQ_AUDIO_CONFIG
+	// A catalog update to mono reopens the decoder: the same packet is twice as many frames
+	fake_moq_set_audio(BROADCAST, "pcm-s16", 48000, 1);
+	fake_moq_catalog_update(BROADCAST);
+	push_packet(11);
+	struct queued_audio mono = newest_audio(context);
+	TEST_CHECK(mono.timestamp_ns == 11ULL * PACKET_US * 1000);
+	TEST_CHECK(mono.frames == PACKET_SAMPLES * 2);
+	TEST_CHECK(mono.speakers == SPEAKERS_MONO);
+	TEST_CHECK(mono.first_sample == 11);
+
+	// A codec the plugin cannot decode stays silent rather than decoding it as something else
+	size_t before = newest_audio(context).count;
+	fake_moq_set_audio(BROADCAST, "flac", 48000, 2);
+	fake_moq_catalog_update(BROADCAST);
+	push_packet(12);
+	TEST_CHECK(newest_audio(context).count == before);
+#endif
+
+	test_release_source(source);
+	TEST_CHECK(fake_moq_open_handles() == 0);
+
+	return test_shutdown();
+}
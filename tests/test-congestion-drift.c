@@ -0,0 +1,154 @@
+/*
+Congestion Policy Clock Drift Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <string.h>
+
+#include "congestion-policy.h"
+#include "test-support.h"
+
+#define AUDIO_INTERVAL_US 20000
+#define VIDEO_INTERVAL_US 33333
+#define NETWORK_DELAY_US 50000
+
+// Frames from a publisher whose clock runs drift_ppm slower than ours, over a network
+// with a little jitter plus whatever queueing delay the test adds, on a simulated clock
+struct sim {
+	struct congestion_policy policy;
+	double drift_ppm;
+	int64_t queue_delay_us;
+	uint32_t jitter_seed;
+
+	uint64_t now_ns;
+	uint64_t next_audio_us;
+	uint64_t next_video_us;
+	bool video_subscribed;
+
+	size_t drops;
+	size_t restores;
+};
+
+static uint64_t arrival_ns(struct sim *sim, uint64_t timestamp_us)
+{
+	sim->jitter_seed = sim->jitter_seed * 1103515245u + 12345u;
+	uint64_t jitter_us = (sim->jitter_seed >> 16) % 3000;
+
+	double local_us = (double)timestamp_us * (1.0 + sim->drift_ppm / 1e6);
+	uint64_t arrival = ((uint64_t)local_us + NETWORK_DELAY_US + (uint64_t)sim->queue_delay_us + jitter_us) * 1000;
+	return arrival > sim->now_ns ? arrival : sim->now_ns;
+}
+
+// Deliver everything the publisher sends in the next stretch of local time
+static void sim_run(struct sim *sim, double seconds)
+{
+	uint64_t end_ns = sim->now_ns + (uint64_t)(seconds * 1e9);
+
+	for (;;) {
+		uint64_t audio_ns = arrival_ns(sim, sim->next_audio_us);
+		uint64_t video_ns = arrival_ns(sim, sim->next_video_us);
+		bool audio = audio_ns <= video_ns;
+		uint64_t next_ns = audio ? audio_ns : video_ns;
+		if (next_ns > end_ns) {
+			break;
+		}
+		sim->now_ns = next_ns;
+
+		if (!audio) {
+			// Video the policy unsubscribed is never delivered
+			if (sim->video_subscribed) {
+				congestion_policy_on_video_frame(&sim->policy, sim->next_video_us, sim->now_ns);
+			}
+			sim->next_video_us += VIDEO_INTERVAL_US;
+			continue;
+		}
+
+		enum congestion_action action =
+			congestion_policy_on_audio_frame(&sim->policy, sim->next_audio_us, sim->now_ns);
+		if (action == CONGESTION_ACTION_DROP_VIDEO) {
+			sim->video_subscribed = false;
+			sim->drops++;
+		} else if (action == CONGESTION_ACTION_RESTORE_VIDEO) {
+			sim->video_subscribed = true;
+			sim->restores++;
+		}
+		sim->next_audio_us += AUDIO_INTERVAL_US;
+	}
+
+	sim->now_ns = end_ns;
+}
+
+static void sim_start(struct sim *sim, double drift_ppm)
+{
+	memset(sim, 0, sizeof(*sim));
+	congestion_policy_reset(&sim->policy, true);
+	sim->drift_ppm = drift_ppm;
+	sim->jitter_seed = 1;
+	sim->video_subscribed = true;
+}
+
+int main(void)
+{
+	struct sim sim;
+
+	// Four hours with the publisher's clock 50 ppm slow: 720 ms of drift, which is not congestion
+	sim_start(&sim, 50.0);
+	sim_run(&sim, 4 * 3600.0);
+	TEST_CHECK(sim.drops == 0);
+	TEST_CHECK(sim.policy.state == CONGESTION_STATE_NORMAL);
+	TEST_CHECK(sim.policy.audio.lateness_us < 50000);
+	TEST_CHECK(sim.policy.video.lateness_us < 50000);
+	TEST_CHECK(!congestion_policy_late(&sim.policy, sim.now_ns));
+
+	// The other way round too
+	sim_start(&sim, -50.0);
+	sim_run(&sim, 4 * 3600.0);
+	TEST_CHECK(sim.drops == 0);
+
+	// Real congestion on top of the drift still sheds video, and it comes back once the queue drains
+	sim_start(&sim, 50.0);
+	sim_run(&sim, 3600.0);
+	sim.queue_delay_us = 800000;
+	sim_run(&sim, 1.0);
+	TEST_CHECK(congestion_policy_late(&sim.policy, sim.now_ns));
+	sim_run(&sim, 9.0);
+	TEST_CHECK(sim.drops == 1);
+	TEST_CHECK(!sim.video_subscribed);
+	sim.queue_delay_us = 0;
+	sim_run(&sim, 2.0);
+
+	// The dropped video's lateness stays where it was, but no longer counts
+	TEST_CHECK(sim.policy.video.lateness_us > 500000);
+	TEST_CHECK(!congestion_policy_late(&sim.policy, sim.now_ns));
+	sim_run(&sim, 28.0);
+	TEST_CHECK(sim.restores == 1);
+	TEST_CHECK(sim.video_subscribed);
+
+	// A delay that never goes away, such as a longer route, stops counting as a deficit
+	// once the baseline history has taken it in, so audio-only is not forever
+	sim_start(&sim, 0.0);
+	sim_run(&sim, 120.0);
+	sim.queue_delay_us = 600000;
+	sim_run(&sim, 10.0);
+	TEST_CHECK(sim.drops == 1);
+	sim_run(&sim, (CONGESTION_BASE_HISTORY + 2) * 60.0);
+	TEST_CHECK(sim.restores >= 1);
+	TEST_CHECK(sim.video_subscribed);
+	TEST_CHECK(sim.policy.state == CONGESTION_STATE_NORMAL);
+
+	return test_shutdown();
+}
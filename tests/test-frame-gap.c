@@ -0,0 +1,102 @@
+/*
+Frame Loss Detection Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+
+#include "frame-gap.h"
+#include "test-support.h"
+
+#define INTERVAL_US 33333
+#define FRAMES 400
+
+// Presentation index of the n-th frame in decode order for a B-pyramid stream:
+// I0, then P4 B2 b1 b3, P8 B6 b5 b7, ...
+static uint32_t pyramid_index(uint32_t n)
+{
+	static const uint32_t order[] = {4, 2, 1, 3};
+	if (n == 0) {
+		return 0;
+	}
+	return ((n - 1) / 4) * 4 + order[(n - 1) % 4];
+}
+
+// Feed a B-pyramid stream, leaving out one presentation index (or none when skip is 0)
+static uint64_t run_pyramid(uint32_t skip)
+{
+	struct frame_gap gap;
+	frame_gap_reset(&gap, FRAME_GAP_VIDEO_REORDER);
+
+	uint64_t lost = 0;
+	for (uint32_t n = 0; n < FRAMES; n++) {
+		uint32_t index = pyramid_index(n);
+		if (skip != 0 && index == skip) {
+			continue;
+		}
+		lost += frame_gap_push(&gap, 1000000 + (uint64_t)index * INTERVAL_US);
+	}
+	return lost;
+}
+
+int main(void)
+{
+	// Reordering alone is not loss
+	TEST_CHECK(run_pyramid(0) == 0);
+
+	// A lost reference or non-reference frame counts once, wherever it sat in the pyramid
+	TEST_CHECK(run_pyramid(100) == 1);
+	TEST_CHECK(run_pyramid(102) == 1);
+	TEST_CHECK(run_pyramid(103) == 1);
+
+	struct frame_gap gap;
+	uint64_t lost = 0;
+
+	// In-order audio: two packets in a row missing
+	frame_gap_reset(&gap, 0);
+	for (uint64_t i = 0; i < 100; i++) {
+		if (i != 50 && i != 51) {
+			lost += frame_gap_push(&gap, i * 20000);
+		}
+	}
+	TEST_CHECK(lost == 2);
+
+	// A lower frame rate is learned instead of being reported forever
+	frame_gap_reset(&gap, FRAME_GAP_VIDEO_REORDER);
+	lost = 0;
+	uint64_t timestamp_us = 0;
+	for (int i = 0; i < 100; i++) {
+		timestamp_us += INTERVAL_US;
+		frame_gap_push(&gap, timestamp_us);
+	}
+	for (int i = 0; i < 100; i++) {
+		timestamp_us += INTERVAL_US * 2;
+		lost += frame_gap_push(&gap, timestamp_us);
+	}
+	TEST_CHECK(lost <= 2);
+
+	// A frame arriving later than the window can follow, or twice, is ignored
+	frame_gap_reset(&gap, 2);
+	lost = 0;
+	for (uint64_t i = 0; i < 20; i++) {
+		lost += frame_gap_push(&gap, i * INTERVAL_US);
+		lost += frame_gap_push(&gap, i * INTERVAL_US);
+	}
+	lost += frame_gap_push(&gap, 3 * INTERVAL_US);
+	TEST_CHECK(lost == 0);
+
+	return test_shutdown();
+}
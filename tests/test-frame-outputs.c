@@ -0,0 +1,133 @@
+/*
+Frame Output Tests for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <string.h>
+
+#include "hang-source.h"
+#include "frame-outputs.h"
+#include "test-support.h"
+
+#define MAX_WIDTH 21
+#define MAX_HEIGHT 7
+
+static uint8_t expected_box(const uint8_t *src, uint32_t src_width, uint32_t x, uint32_t y, uint32_t c)
+{
+	size_t stride = (size_t)src_width * 4;
+	const uint8_t *p = src + (size_t)y * 2 * stride + (size_t)x * 8 + c;
+	return (uint8_t)((p[0] + p[4] + p[stride] + p[stride + 4] + 2) >> 2);
+}
+
+// Every reduced channel must equal the rounded average of its 2x2 block; widths cover
+// whole vector steps, leftover pixels, and odd columns and rows that are dropped
+static void check_reduce(uint32_t src_width, uint32_t src_height, uint32_t seed)
+{
+	uint8_t src[MAX_WIDTH * MAX_HEIGHT * 4];
+	uint8_t dst[(MAX_WIDTH / 2) * (MAX_HEIGHT / 2) * 4 + 16];
+
+	for (size_t i = 0; i < sizeof(src); i++) {
+		seed = seed * 1103515245u + 12345u;
+		src[i] = (uint8_t)(seed >> 16);
+	}
+	memset(dst, 0xAA, sizeof(dst));
+
+	frame_output_reduce(src, src_width, src_height, dst);
+
+	uint32_t dst_width = src_width / 2;
+	uint32_t dst_height = src_height / 2;
+	bool exact = true;
+	for (uint32_t y = 0; y < dst_height; y++) {
+		for (uint32_t x = 0; x < dst_width; x++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				if (dst[((size_t)y * dst_width + x) * 4 + c] != expected_box(src, src_width, x, y, c)) {
+					exact = false;
+				}
+			}
+		}
+	}
+	TEST_CHECK(exact);
+
+	// Nothing written past the reduced image
+	TEST_CHECK(dst[(size_t)dst_width * dst_height * 4] == 0xAA);
+}
+
+static void set_output(struct hang_source *context, uint32_t level, bool present, uint64_t frame_id)
+{
+	static uint8_t pixels[4];
+	context->outputs[level].data = present ? pixels : NULL;
+	context->outputs[level].frame_id = frame_id;
+}
+
+int main(void)
+{
+	check_reduce(8, 2, 1);
+	check_reduce(10, 4, 2);
+	check_reduce(21, 7, 3);
+	check_reduce(2, 2, 4);
+	check_reduce(1, 1, 5);
+
+	// Rounding: a quarter rounds down, three quarters up, and full white stays white
+	uint8_t src[16] = {0, 1, 255, 0, 1, 1, 255, 0, 0, 0, 255, 1, 0, 1, 255, 2};
+	uint8_t dst[4];
+	frame_output_reduce(src, 2, 2, dst);
+	TEST_CHECK(dst[0] == 0);
+	TEST_CHECK(dst[1] == 1);
+	TEST_CHECK(dst[2] == 255);
+	TEST_CHECK(dst[3] == 1);
+
+	static struct hang_source context;
+	struct frame_output *outputs = context.outputs;
+
+	// Nothing decoded yet
+	TEST_CHECK(frame_outputs_select(&context, 0) == NULL);
+
+	// All sizes of the same frame: the requested one
+	for (uint32_t level = 0; level < FRAME_OUTPUT_LEVELS; level++) {
+		set_output(&context, level, true, 5);
+	}
+	for (uint32_t level = 0; level < FRAME_OUTPUT_LEVELS; level++) {
+		TEST_CHECK(frame_outputs_select(&context, level) == &outputs[level]);
+	}
+
+	// Requested size missing: the next larger one before any smaller one
+	set_output(&context, 1, false, 0);
+	TEST_CHECK(frame_outputs_select(&context, 1) == &outputs[0]);
+	set_output(&context, 0, false, 0);
+	TEST_CHECK(frame_outputs_select(&context, 1) == &outputs[2]);
+	set_output(&context, 2, false, 0);
+	set_output(&context, 1, true, 5);
+	set_output(&context, 0, true, 5);
+	TEST_CHECK(frame_outputs_select(&context, 2) == &outputs[1]);
+	set_output(&context, 0, false, 0);
+	TEST_CHECK(frame_outputs_select(&context, 0) == &outputs[1]);
+
+	// A newer frame wins over the requested size of an older one
+	set_output(&context, 0, true, 5);
+	set_output(&context, 1, true, 5);
+	set_output(&context, 2, true, 6);
+	TEST_CHECK(frame_outputs_select(&context, 0) == &outputs[2]);
+	TEST_CHECK(frame_outputs_select(&context, 1) == &outputs[2]);
+
+	// Only the full size, as decode hosts deliver
+	set_output(&context, 1, false, 0);
+	set_output(&context, 2, false, 0);
+	set_output(&context, 0, true, 7);
+	TEST_CHECK(frame_outputs_select(&context, 2) == &outputs[0]);
+
+	return test_shutdown();
+}
@@ -0,0 +1,222 @@
+/*
+H.264 Join Point Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <string.h>
+
+#include "nal-join.h"
+#include "test-support.h"
+
+#define NAL_SEI 0x06
+#define NAL_IDR 0x65
+#define NAL_SLICE 0x41
+
+struct nal {
+	uint8_t data[2048];
+	size_t size;
+	int zeros;
+};
+
+// Append RBSP bytes, inserting emulation prevention bytes as an encoder would
+static void nal_put(struct nal *nal, const uint8_t *bytes, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (nal->zeros >= 2 && bytes[i] <= 0x03) {
+			nal->data[nal->size++] = 0x03;
+			nal->zeros = 0;
+		}
+		nal->data[nal->size++] = bytes[i];
+		nal->zeros = bytes[i] == 0x00 ? nal->zeros + 1 : 0;
+	}
+}
+
+static void nal_put_byte(struct nal *nal, uint8_t byte)
+{
+	nal_put(nal, &byte, 1);
+}
+
+static void nal_start(struct nal *nal, uint8_t header)
+{
+	memset(nal, 0, sizeof(*nal));
+	nal->data[nal->size++] = header;
+}
+
+// SEI type and size fields in their 0xFF-run encoding
+static void nal_put_sei_value(struct nal *nal, uint32_t value)
+{
+	while (value >= 255) {
+		nal_put_byte(nal, 0xFF);
+		value -= 255;
+	}
+	nal_put_byte(nal, (uint8_t)value);
+}
+
+static void nal_put_sei(struct nal *nal, uint32_t type, const uint8_t *payload, size_t size)
+{
+	nal_put_sei_value(nal, type);
+	nal_put_sei_value(nal, (uint32_t)size);
+	nal_put(nal, payload, size);
+}
+
+// user_data_unregistered: a UUID, then bytes that need escaping in the NAL
+static void nal_put_user_data(struct nal *nal, size_t size)
+{
+	uint8_t payload[1024] = {0};
+	for (size_t i = 16; i < size; i++) {
+		payload[i] = (i % 3 == 2) ? 0x01 : 0x00;
+	}
+	nal_put_sei(nal, 5, payload, size);
+}
+
+static struct nal_join_info scan(const struct nal *nal)
+{
+	struct nal_join_info join = {0};
+	nal_join_scan(nal->data, nal->size, &join);
+	return join;
+}
+
+static void test_parser(void)
+{
+	struct nal nal;
+	struct nal_join_info join;
+
+	// recovery_frame_cnt = 5, exact_match 0, broken_link 0, changing_slice_group_idc 0
+	static const uint8_t recovery_5[] = {0x30, 0x40};
+	nal_start(&nal, NAL_SEI);
+	nal_put_sei(&nal, 6, recovery_5, sizeof(recovery_5));
+	nal_put_byte(&nal, 0x80);
+	join = scan(&nal);
+	TEST_CHECK(join.recovery_point);
+	TEST_CHECK(join.recovery_frame_cnt == 5);
+	TEST_CHECK(!join.idr);
+
+	// Behind a large user data message, well past any fixed-size copy
+	nal_start(&nal, NAL_SEI);
+	nal_put_user_data(&nal, 700);
+	nal_put_sei(&nal, 6, recovery_5, sizeof(recovery_5));
+	nal_put_byte(&nal, 0x80);
+	TEST_CHECK(nal.size > 700 + 100);
+	join = scan(&nal);
+	TEST_CHECK(join.recovery_point);
+	TEST_CHECK(join.recovery_frame_cnt == 5);
+
+	// A count whose Exp-Golomb code itself needs emulation prevention: 23 leading zeros
+	static const uint8_t recovery_large[] = {0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x08};
+	nal_start(&nal, NAL_SEI);
+	nal_put_sei(&nal, 6, recovery_large, sizeof(recovery_large));
+	nal_put_byte(&nal, 0x80);
+	TEST_CHECK(nal.size > 1 + 2 + sizeof(recovery_large) + 1);
+	join = scan(&nal);
+	TEST_CHECK(join.recovery_point);
+	TEST_CHECK(join.recovery_frame_cnt == (1u << 23) - 1);
+
+	// Other messages only, with trailing zero padding: no join point
+	nal_start(&nal, NAL_SEI);
+	nal_put_user_data(&nal, 300);
+	nal_put_byte(&nal, 0x80);
+	nal.data[nal.size++] = 0x00;
+	join = scan(&nal);
+	TEST_CHECK(!join.recovery_point);
+
+	// A payload size running past the NAL is rejected, not read out of bounds
+	nal_start(&nal, NAL_SEI);
+	nal_put_sei_value(&nal, 6);
+	nal_put_sei_value(&nal, 40);
+	nal_put(&nal, recovery_5, 1);
+	join = scan(&nal);
+	TEST_CHECK(!join.recovery_point);
+
+	// Truncated in the middle of a type field
+	nal_start(&nal, NAL_SEI);
+	nal_put_byte(&nal, 0xFF);
+	join = scan(&nal);
+	TEST_CHECK(!join.recovery_point);
+
+	// Slices: only IDR slices count
+	nal_start(&nal, NAL_IDR);
+	nal_put_byte(&nal, 0x88);
+	join = scan(&nal);
+	TEST_CHECK(join.idr);
+	TEST_CHECK(!join.recovery_point);
+
+	nal_start(&nal, NAL_SLICE);
+	nal_put_byte(&nal, 0x9A);
+	join = scan(&nal);
+	TEST_CHECK(!join.idr);
+
+	// The first recovery point in an access unit wins
+	nal_start(&nal, NAL_SEI);
+	nal_put_sei(&nal, 6, recovery_5, sizeof(recovery_5));
+	nal_put_byte(&nal, 0x80);
+	join = scan(&nal);
+	nal_start(&nal, NAL_SEI);
+	nal_put_sei(&nal, 6, recovery_large, sizeof(recovery_large));
+	nal_put_byte(&nal, 0x80);
+	nal_join_scan(nal.data, nal.size, &join);
+	TEST_CHECK(join.recovery_frame_cnt == 5);
+
+	// Empty NAL units are ignored
+	join = (struct nal_join_info){0};
+	nal_join_scan(nal.data, 0, &join);
+	TEST_CHECK(!join.idr && !join.recovery_point);
+}
+
+static void test_gate(void)
+{
+	bool synced = false;
+	uint32_t refresh = 0;
+	struct nal_join_info none = {0};
+	struct nal_join_info idr = {.idr = true};
+	struct nal_join_info recovery = {.recovery_point = true, .recovery_frame_cnt = 12};
+
+	// Nothing decodes before a join point
+	TEST_CHECK(!nal_join_gate(&synced, &refresh, false, &none));
+	TEST_CHECK(!synced);
+
+	// A recovery point joins with the refresh period held back
+	TEST_CHECK(nal_join_gate(&synced, &refresh, false, &recovery));
+	TEST_CHECK(synced);
+	TEST_CHECK(refresh == 12);
+
+	// Once synced everything passes and the refresh count is left to the decoder
+	TEST_CHECK(nal_join_gate(&synced, &refresh, false, &none));
+	TEST_CHECK(refresh == 12);
+
+	// A keyframe flag or an IDR slice joins with nothing hidden
+	synced = false;
+	TEST_CHECK(nal_join_gate(&synced, &refresh, true, &none));
+	TEST_CHECK(refresh == 0);
+
+	synced = false;
+	refresh = 7;
+	TEST_CHECK(nal_join_gate(&synced, &refresh, false, &idr));
+	TEST_CHECK(refresh == 0);
+
+	// An IDR wins over a recovery point in the same access unit
+	synced = false;
+	struct nal_join_info both = {.idr = true, .recovery_point = true, .recovery_frame_cnt = 30};
+	TEST_CHECK(nal_join_gate(&synced, &refresh, false, &both));
+	TEST_CHECK(refresh == 0);
+}
+
+int main(void)
+{
+	test_parser();
+	test_gate();
+	return test_shutdown();
+}
@@ -0,0 +1,134 @@
+/*
+Relay Re-Publish Test for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+
+#include "fake-moq.h"
+#include "test-support.h"
+
+#define UPSTREAM_URL "https://upstream.test/"
+#define EDGE_URL "https://edge.test/"
+#define BACKUP_URL "https://backup.test/"
+#define BROADCAST "live/cam"
+#define OTHER_BROADCAST "live/other"
+
+static void set_relay_url(obs_source_t *source, const char *relay_url)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "relay_url", relay_url);
+	test_update_source(source, settings);
+	obs_data_release(settings);
+}
+
+static void announce(bool active)
+{
+	fake_moq_announce(UPSTREAM_URL, BROADCAST, active);
+
+	// Connect whatever relay session the announcement started
+	int32_t edge = fake_moq_session(EDGE_URL);
+	if (edge > 0) {
+		fake_moq_session_status(edge, 0);
+	}
+	int32_t backup = fake_moq_session(BACKUP_URL);
+	if (backup > 0) {
+		fake_moq_session_status(backup, 0);
+	}
+}
+
+int main(void)
+{
+	if (!test_startup()) {
+		return 1;
+	}
+
+	obs_source_t *source = test_create_source(UPSTREAM_URL, BROADCAST, EDGE_URL);
+	TEST_CHECK(source != NULL);
+
+	int32_t upstream = fake_moq_session(UPSTREAM_URL);
+	TEST_CHECK(upstream > 0);
+	fake_moq_session_status(upstream, 0);
+
+	// Nothing to re-publish until the broadcast is live
+	TEST_CHECK(fake_moq_session(EDGE_URL) == 0);
+
+#ifndef HAVE_MOQ_ORIGIN_PUBLISH
+	// Without a way to publish a single broadcast, the relay URL is ignored
+	announce(true);
+	TEST_CHECK(fake_moq_session(EDGE_URL) == 0);
+	TEST_CHECK(fake_moq_connect_count(EDGE_URL) == 0);
+	test_release_source(source);
+	TEST_CHECK(fake_moq_open_handles() == 0);
+	TEST_CHECK(fake_moq_bad_closes() == 0);
+	return test_shutdown();
+#else
+	// Another broadcast live on the upstream relay beforehand
+	fake_moq_announce(UPSTREAM_URL, OTHER_BROADCAST, true);
+
+	// The relay session publishes an origin of its own holding the consumed broadcast, so
+	// the edge gets it without anything being decoded or copied
+	announce(true);
+	int32_t edge = fake_moq_session(EDGE_URL);
+	TEST_CHECK(edge > 0);
+	TEST_CHECK(fake_moq_session_publish_origin(edge) > 0);
+	TEST_CHECK(fake_moq_session_publish_origin(edge) != fake_moq_session_consume_origin(upstream));
+	TEST_CHECK(fake_moq_session_consume_origin(edge) == 0);
+	TEST_CHECK(fake_moq_published(EDGE_URL, BROADCAST));
+
+	// Only that broadcast: others announced upstream, before or after, stay off the edge
+	TEST_CHECK(!fake_moq_published(EDGE_URL, OTHER_BROADCAST));
+	fake_moq_announce(UPSTREAM_URL, "live/late", true);
+	TEST_CHECK(!fake_moq_published(EDGE_URL, "live/late"));
+
+	// Unannounced upstream: the edge loses it and the relay session closes
+	announce(false);
+	TEST_CHECK(!fake_moq_published(EDGE_URL, BROADCAST));
+	TEST_CHECK(fake_moq_session(EDGE_URL) == 0);
+	TEST_CHECK(fake_moq_close_count(EDGE_URL) == 1);
+
+	// Back live: re-published again
+	announce(true);
+	TEST_CHECK(fake_moq_published(EDGE_URL, BROADCAST));
+	TEST_CHECK(fake_moq_connect_count(EDGE_URL) == 2);
+
+	// Moving the relay restarts only the relay session, never local playback
+	set_relay_url(source, BACKUP_URL);
+	fake_moq_session_status(fake_moq_session(BACKUP_URL), 0);
+	TEST_CHECK(fake_moq_session(EDGE_URL) == 0);
+	TEST_CHECK(fake_moq_published(BACKUP_URL, BROADCAST));
+	TEST_CHECK(!fake_moq_published(BACKUP_URL, OTHER_BROADCAST));
+	TEST_CHECK(fake_moq_session(UPSTREAM_URL) == upstream);
+	TEST_CHECK(fake_moq_close_count(UPSTREAM_URL) == 0);
+
+	// Clearing it stops re-publishing, still without touching playback
+	set_relay_url(source, "");
+	TEST_CHECK(fake_moq_session(BACKUP_URL) == 0);
+	TEST_CHECK(fake_moq_session(UPSTREAM_URL) == upstream);
+
+	// Re-enabled while live, it starts straight away
+	set_relay_url(source, EDGE_URL);
+	TEST_CHECK(fake_moq_published(EDGE_URL, BROADCAST));
+
+	// Deactivation unpublishes and closes every handle exactly once
+	test_release_source(source);
+	TEST_CHECK(!fake_moq_published(EDGE_URL, BROADCAST));
+	TEST_CHECK(fake_moq_open_handles() == 0);
+	TEST_CHECK(fake_moq_bad_closes() == 0);
+
+	return test_shutdown();
+#endif
+}
@@ -0,0 +1,43 @@
+/*
+Test Support for OBS Hang Source
+Copyright (C) 2024 OBS Plugin Template
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+struct hang_source;
+
+// Record a failure and keep going, so one run reports every broken expectation
+#define TEST_CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+void test_check(bool ok, const char *expr, const char *file, int line);
+
+// Start libobs with the hang source registered, and shut it down again.
+// test_shutdown returns the process exit code.
+bool test_startup(void);
+int test_shutdown(void);
+
+// Create a source with these settings; relay_url may be NULL
+obs_source_t *test_create_source(const char *url, const char *broadcast, const char *relay_url);
+struct hang_source *test_source_context(obs_source_t *source);
+// Apply settings right away; obs_source_update defers this to a video tick that tests never run
+void test_update_source(obs_source_t *source, obs_data_t *settings);
+// Put a source on program; libobs signals this from the video thread, which tests do not run
+void test_activate_source(obs_source_t *source);
+// Release a source and wait until it has been destroyed
+void test_release_source(obs_source_t *source);